@@ -2,27 +2,126 @@
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
+in vec3 ViewPos;
+in vec3 ViewNormal;
+in float Occlusion;
+#ifdef TEXTURE_ARRAY
+in float Layer;
+#endif
+#ifdef LIGHTMAPPED
+in vec2 LightmapCoord;
+uniform sampler2D lightmap;
+#endif
 
 out vec4 FragColor;
 
+#if defined(TEXTURE_ARRAY)
+uniform sampler2DArray texArray;
+#elif defined(TEXTURED)
 uniform sampler2D tex0;
-uniform int useTex;
-uniform int isEmitter;
+#else
 uniform vec3 objectColor;
+#endif
 
 uniform vec3 lightPos;
 uniform vec3 lightColor;
 uniform float lightIntensity;
 uniform vec3 viewPos;
 
+#ifndef EMISSIVE
+// point lights binned per froxel by LightClusters; the grid size must match it
+const int clusterTilesX = 16;
+const int clusterTilesY = 9;
+const int clusterSlices = 24;
+uniform samplerBuffer clusterLights;  // position + radius, color per light
+uniform usamplerBuffer clusterGrid;   // first index, count per froxel
+uniform usamplerBuffer clusterIndices;
+uniform vec3 clusterScale;            // 1 / tile width, 1 / tile height, slices / log(far / near)
+uniform float clusterNear;
+
+vec3 PointLights(vec3 baseColor, vec3 norm, vec3 viewDir) {
+    ivec2 tile = ivec2(gl_FragCoord.xy * clusterScale.xy);
+    int slice = int(log(max(-ViewPos.z, clusterNear) / clusterNear) * clusterScale.z);
+    tile = clamp(tile, ivec2(0), ivec2(clusterTilesX - 1, clusterTilesY - 1));
+    slice = clamp(slice, 0, clusterSlices - 1);
+    uvec2 cell = texelFetch(clusterGrid, (slice * clusterTilesY + tile.y) * clusterTilesX + tile.x).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < cell.y; ++i) {
+        int light = int(texelFetch(clusterIndices, int(cell.x + i)).r);
+        vec4 posRadius = texelFetch(clusterLights, light * 2);
+        vec3 color = texelFetch(clusterLights, light * 2 + 1).rgb;
+
+        vec3 toLight = posRadius.xyz - ViewPos;
+        float dist = length(toLight);
+        vec3 lightDir = toLight / max(dist, 1e-4);
+        // inverse square, windowed to reach zero at the radius
+        float window = clamp(1.0 - pow(dist / posRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (1.0 + dist * dist);
+
+        float diffFactor = max(dot(norm, lightDir), 0.0);
+        float specFactor = pow(max(dot(norm, normalize(lightDir + viewDir)), 0.0), 8.0);
+        result += (diffFactor * baseColor + specFactor * 0.5) * color * attenuation;
+    }
+    return result;
+}
+
+// shadows from the main light, see ShadowMap. the static map holds one
+// world segment in its own space, so positions are folded into it first
+uniform sampler2DShadow staticShadow;
+uniform sampler2DShadow dynamicShadow;
+uniform mat4 staticShadowMatrix;
+uniform mat4 dynamicShadowMatrix;
+uniform int staticShadowOn;
+uniform int dynamicShadowOn;
+uniform float segmentPhase;
+uniform float segmentPeriod;
+uniform mat4 toWorld;
+
+// 0 lit, 1 fully shadowed
+float StaticShadow(vec3 world) {
+    if (staticShadowOn == 0)
+        return 0.0;
+    vec3 local = world;
+    local.z -= segmentPhase;
+    local.z -= segmentPeriod * floor(local.z / segmentPeriod + 0.5);
+    vec4 coord = staticShadowMatrix * vec4(local, 1.0);
+    return 1.0 - texture(staticShadow, coord.xyz);
+}
+
+float DynamicShadow(vec3 world) {
+    if (dynamicShadowOn == 0)
+        return 0.0;
+    vec4 coord = dynamicShadowMatrix * vec4(world, 1.0);
+    return 1.0 - texture(dynamicShadow, coord.xyz);
+}
+#endif
+
 void main() {
+#if defined(TEXTURE_ARRAY)
+    vec3 baseColor = texture(texArray, vec3(TexCoord, Layer)).rgb;
+#elif defined(TEXTURED)
+    vec3 baseColor = texture(tex0, TexCoord).rgb;
+#else
     vec3 baseColor = objectColor;
-    if (useTex == 1) {
-        baseColor = texture(tex0, TexCoord).rgb;
-    }
+#endif
 
+#ifdef EMISSIVE
+    // Emissive rendering: objectColor is the emitter's light color times its
+    // intensity; make it very bright so it's clearly visible.
+    FragColor = vec4(objectColor * 4.0, 1.0);
+#elif defined(LIGHTMAPPED)
+    // sun, sky and bounce were baked; only the dynamic point lights remain.
+    // moving casters take away the sun's share of the texel. corner occlusion
+    // darkens only the indirect share: the sun's is already shadowed by the bake
+    vec4 baked = texture(lightmap, LightmapCoord);
+    vec3 world = vec3(toWorld * vec4(FragPos, 1.0));
+    vec3 result = baseColor * baked.rgb * mix(Occlusion, 1.0, baked.a) * (1.0 - baked.a * DynamicShadow(world));
+    result += PointLights(baseColor, normalize(ViewNormal), normalize(-ViewPos));
+    FragColor = vec4(result, 1.0);
+#else
     // ambient term (soft)
-    vec3 ambient = 0.22 * baseColor;
+    vec3 ambient = 0.22 * baseColor * Occlusion;
 
     // lighting calculations
     vec3 norm = normalize(Normal);
@@ -45,13 +144,12 @@ void main() {
     float specFactor = pow(max(dot(norm, halfway), 0.0), 8.0);
     vec3 specular = specFactor * lightColor * lightIntensity * attenuation * 0.5;
 
-    vec3 result = ambient + diffuse + specular;
+    vec3 world = vec3(toWorld * vec4(FragPos, 1.0));
+    float shadow = max(StaticShadow(world), DynamicShadow(world));
 
-    if (isEmitter == 1) {
-        // Emissive/sun rendering: make it very bright so it's clearly visible.
-        vec3 emissive = lightColor * lightIntensity * 4.0 + baseColor * 0.2;
-        FragColor = vec4(emissive, 1.0);
-    } else {
-        FragColor = vec4(result, 1.0);
-    }
+    vec3 result = ambient + (diffuse + specular) * (1.0 - shadow);
+    result += PointLights(baseColor, normalize(ViewNormal), normalize(-ViewPos));
+
+    FragColor = vec4(result, 1.0);
+#endif
 }
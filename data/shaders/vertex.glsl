@@ -1,20 +1,64 @@
 #version 330 core
+// features arrive as #defines injected after the #version line:
+// TEXTURED, TEXTURE_ARRAY, EMISSIVE, INSTANCED, LIGHTMAPPED
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTex;
+#ifdef TEXTURE_ARRAY
+layout(location = 3) in float aLayer;
+#endif
+#ifdef LIGHTMAPPED
+// MeshBatch extras are scalar attributes
+layout(location = 4) in float aLightmapU;
+layout(location = 5) in float aLightmapV;
+#endif
+// baked ambient occlusion; meshes without it read the constant 1 RenderSystem sets
+layout(location = 6) in float aOcclusion;
+#ifdef INSTANCED
+// per-instance matrices, one column per location
+layout(location = 8) in mat4 aModel;
+layout(location = 12) in mat3 aNormalMatrix;
+#endif
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
+// view-space position and normal for the clustered point lights
+out vec3 ViewPos;
+out vec3 ViewNormal;
+out float Occlusion;
+#ifdef TEXTURE_ARRAY
+out float Layer;
+#endif
+#ifdef LIGHTMAPPED
+out vec2 LightmapCoord;
+#endif
 
+#ifndef INSTANCED
 uniform mat4 model;
+// inverse-transpose of mat3(model), computed once per object on the CPU
+uniform mat3 normalMatrix;
+#endif
 uniform mat4 view;
 uniform mat4 proj;
 
 void main() {
+#ifdef INSTANCED
+    mat4 model = aModel;
+    mat3 normalMatrix = aNormalMatrix;
+#endif
     FragPos = vec3(model * vec4(aPos, 1.0));
-    mat3 normalMat = transpose(inverse(mat3(model)));
-    Normal = normalize(normalMat * aNormal);
+    Normal = normalize(normalMatrix * aNormal);
     TexCoord = aTex;
+    Occlusion = aOcclusion;
+    ViewPos = vec3(view * vec4(FragPos, 1.0));
+    // the view matrix is rigid, so its upper 3x3 moves normals too
+    ViewNormal = mat3(view) * Normal;
+#ifdef TEXTURE_ARRAY
+    Layer = aLayer;
+#endif
+#ifdef LIGHTMAPPED
+    LightmapCoord = vec2(aLightmapU, aLightmapV);
+#endif
     gl_Position = proj * view * vec4(FragPos, 1.0);
 }
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "ecs/Texture.hpp"
+
+// decodes images on worker threads. GL work stays on the main thread: Pump
+// uploads finished images a few per frame, within a time budget.
+class AsyncTextureLoader
+{
+public:
+    // workers = 0 picks hardware_concurrency - 1 (at least one)
+    static void Start(int workers = 0);
+    // joins the workers and drops anything not uploaded yet
+    static void Stop();
+    static bool IsRunning();
+
+    // returns a texture that shows a placeholder until the decoded image is uploaded.
+    // if decoding fails the texture shows Texture::UploadMissing's checker instead
+    // and onFailed runs on the main thread.
+    static GLuint Request(const std::string &path, const TextureSettings &settings = {},
+                          std::function<void(GLuint)> onFailed = {});
+    // forget a pending Request, e.g. because its texture is being deleted
+    static void Cancel(GLuint tex);
+
+    // decode path on a worker, then call onReady on the main thread from Pump.
+    // onReady may move the pixels out. it is not called if decoding fails.
+    static void Submit(const std::string &path, bool flip, std::function<void(DecodedImage &)> onReady);
+    // run work on a worker, then onDone on the main thread from Pump.
+    // without workers both run immediately.
+    static void RunOnWorker(std::function<void()> work, std::function<void()> onDone);
+
+    // run finished jobs until maxJobs ran or budgetMs elapsed (at least one job runs)
+    static void Pump(double budgetMs = 2.0, int maxJobs = 4);
+    // blocks until everything submitted so far has been uploaded
+    static void Flush();
+
+    static size_t Pending();
+};
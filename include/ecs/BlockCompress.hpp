@@ -0,0 +1,13 @@
+#pragma once
+#include <vector>
+#include "ecs/ImageUtils.hpp"
+
+// minimal S3TC encoders: bounding-box endpoints, nearest-index fit. good
+// enough for tiled world textures, and fast enough to run at bake time.
+namespace BlockCompress
+{
+    // 3 or 4 channel input; 8 bytes per 4x4 block, alpha ignored
+    std::vector<unsigned char> EncodeBC1(const DecodedImage &image);
+    // 4 channel input; 16 bytes per 4x4 block
+    std::vector<unsigned char> EncodeBC3(const DecodedImage &image);
+}
@@ -7,3 +7,11 @@ struct Bullet
     float speed = 30.0f;
     float ttl = 5.0f; // seconds
 };
+
+// short-lived point light at the muzzle; fades out over its duration
+struct MuzzleFlash
+{
+    float ttl = 0.06f;
+    float duration = 0.06f;
+    float intensity = 6.0f;
+};
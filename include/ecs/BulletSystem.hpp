@@ -10,5 +10,6 @@ class BulletSystem : public System
 public:
     BulletSystem();
     void Update(Registry &registry, float dt) override;
+    void Cleanup();
     void SpawnBullet(Registry &registry, const glm::vec3 &pos, const glm::vec3 &dir, float speed = 30.0f, float ttl = 5.0f);
 };
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// pixels decoded from an image file, rows top to bottom unless flipped
+struct DecodedImage
+{
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// CPU-side helpers for decoded images. nothing here touches GL, so the
+// offline tools can share it.
+namespace ImageUtils
+{
+    // safe to call from any thread. flip puts the bottom row first, as GL expects.
+    bool Decode(const std::string &path, bool flip, DecodedImage &out);
+
+    // copy a w x h rectangle starting at (x, y), one memcpy per row
+    DecodedImage Extract(const DecodedImage &src, int x, int y, int w, int h);
+
+    // expands 1 and 3 channel images to RGBA (alpha 255)
+    DecodedImage ToRgba(const DecodedImage &src);
+
+    // bilinear resample to exactly w x h; meant for small adjustments after Downsample
+    DecodedImage Resize(const DecodedImage &src, int w, int h);
+
+    // next mip level: 2x2 box filter, odd edges are clamped. never below 1x1.
+    DecodedImage Downsample(const DecodedImage &src);
+}
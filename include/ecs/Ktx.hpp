@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ecs/ImageUtils.hpp"
+
+// KTX 1.1 container holding a full mip chain, either plain 8-bit texels or
+// S3TC (BC1/BC3) blocks. GL enum values are spelled out so this stays GL-free
+// and can be shared with tools/texbake.
+namespace Ktx
+{
+    constexpr uint32_t UnsignedByte = 0x1401;
+    constexpr uint32_t Red = 0x1903;
+    constexpr uint32_t Rgb = 0x1907;
+    constexpr uint32_t Rgba = 0x1908;
+    constexpr uint32_t R8 = 0x8229;
+    constexpr uint32_t Rgb8 = 0x8051;
+    constexpr uint32_t Rgba8 = 0x8058;
+    constexpr uint32_t Bc1 = 0x83F0; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    constexpr uint32_t Bc3 = 0x83F3; // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+
+    struct Image
+    {
+        uint32_t glType = 0; // 0 for compressed data
+        uint32_t glFormat = 0;
+        uint32_t glInternalFormat = 0;
+        uint32_t glBaseInternalFormat = 0;
+        int width = 0;
+        int height = 0;
+        // level 0 first. uncompressed rows are padded to 4 bytes, so they
+        // upload with the default GL_UNPACK_ALIGNMENT.
+        std::vector<std::vector<unsigned char>> levels;
+
+        bool IsCompressed() const { return glType == 0; }
+    };
+
+    // builds every mip level down to 1x1. compress selects BC1 for RGB and
+    // BC3 for RGBA; single-channel images are always stored uncompressed.
+    Image Build(const DecodedImage &image, bool compress);
+
+    bool Read(const std::string &path, Image &out);
+    bool Write(const std::string &path, const Image &image);
+
+    // where the baked variants of an image live: grass.jpg -> grass.ktx / grass.bc.ktx
+    std::string PathFor(const std::string &sourcePath, bool compressed);
+}
@@ -5,4 +5,7 @@ struct Light
 {
     glm::vec3 color{1.0f, 1.0f, 1.0f};
     float intensity = 1.0f;
+    // 0 for the scene's main light; otherwise a point light reaching this far,
+    // culled per froxel by LightClusters
+    float radius = 0.0f;
 };
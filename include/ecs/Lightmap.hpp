@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// the static map as the baker sees it: a grid of solid wall columns
+// standing on a ground plane at y = 0
+struct LightmapScene
+{
+    int rows = 0;
+    int cols = 0;
+    float tileSize = 1.0f;
+    float wallHeight = 2.0f;
+    // world x/z of the outer corner of cell (0, 0)
+    glm::vec2 origin{0.0f};
+    // rows * cols, 1 where a wall stands
+    std::vector<uint8_t> solid;
+    // the map repeats along z (WorldRepeater), so rays wrap rows
+    bool wrapRows = true;
+};
+
+struct LightmapSettings
+{
+    // toward the light; the sun is baked as a directional light
+    glm::vec3 sunDirection{0.0f, 1.0f, 0.0f};
+    glm::vec3 sunColor{1.0f};
+    // radiance of the open sky, i.e. the ambient term where nothing occludes it
+    glm::vec3 skyColor{0.22f};
+    float bounceAlbedo = 0.4f;
+    int samples = 64;
+    float texelsPerUnit = 8.0f;
+    float maxDistance = 32.0f;
+};
+
+// static lighting for the world segment, baked on the CPU. every lit
+// surface is a chart: a rectangle in world space with its own block of
+// texels in one atlas. each texel gathers the sun (shadow ray), the sky and
+// one diffuse bounce by casting rays through the tile grid, spread over
+// worker threads. results are cached on disk keyed by the map, the charts
+// and the settings, so later loads skip the bake.
+class Lightmap
+{
+public:
+    Lightmap() = default;
+    ~Lightmap() { Clear(); }
+    Lightmap(const Lightmap &) = delete;
+    Lightmap &operator=(const Lightmap &) = delete;
+
+    // origin + s * axisU + t * axisV for s, t in [0, 1]; normal faces the lit side.
+    // returns the chart index. texel counts follow texelsPerUnit.
+    int AddChart(const glm::vec3 &origin, const glm::vec3 &axisU, const glm::vec3 &axisV, const glm::vec3 &normal,
+                 float texelsPerUnit);
+    // places every chart in the atlas; AtlasUV is valid afterwards
+    void Pack();
+    // atlas coordinates of pos projected onto the chart's plane
+    glm::vec2 AtlasUV(int chart, const glm::vec3 &pos) const;
+
+    // loads the cached bake or bakes and stores it. workers = 0 uses every core.
+    bool Bake(const LightmapScene &scene, const LightmapSettings &settings, const std::string &cacheDir = "cache/lightmaps",
+              int workers = 0);
+    // RGBA16F, linear. RGB is multiplied with the base color in the LIGHTMAPPED
+    // variant; A is the sun's share of it, removed under dynamic shadows
+    GLuint Upload();
+    // bakes again with new settings (e.g. the sun was edited) on an
+    // AsyncTextureLoader worker, off a copy of the charts. the current texels
+    // stay bound until the result is copied into the same texture from Pump.
+    // call after Upload; ignored while a rebake is running.
+    void Rebake(const LightmapScene &scene, const LightmapSettings &settings, const std::string &cacheDir = "cache/lightmaps");
+    bool Rebaking() const { return rebaking; }
+    void Free();
+    // drops the charts and texels too
+    void Clear();
+
+    GLuint Id() const { return texture; }
+    int Width() const { return width; }
+    int Height() const { return height; }
+    size_t ChartCount() const { return charts.size(); }
+    bool FromCache() const { return cached; }
+
+private:
+    struct Chart
+    {
+        glm::vec3 origin, axisU, axisV, normal;
+        int texelsU = 1, texelsV = 1;
+        int x = 0, y = 0; // atlas position of texel (0, 0)
+    };
+
+    uint64_t Key(const LightmapScene &scene, const LightmapSettings &settings) const;
+    // workers claim atlas rows until none are left; rows never overlap
+    void BakeRows(const LightmapScene &scene, const LightmapSettings &settings, std::atomic<int> &nextRow);
+    // copies chart borders into the gutter texels around them
+    void Dilate();
+
+    std::vector<Chart> charts;
+    // chart per atlas texel, -1 for gutter and free space
+    std::vector<int> owner;
+    std::vector<float> texels; // RGBA
+    int width = 0, height = 0;
+    bool cached = false;
+    GLuint texture = 0;
+    bool rebaking = false;
+    // cleared by Clear so a late rebake doesn't touch a dead lightmap
+    std::shared_ptr<bool> alive;
+};
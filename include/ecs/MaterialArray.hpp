@@ -0,0 +1,54 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "ecs/Texture.hpp"
+
+// tile materials packed into one GL_TEXTURE_2D_ARRAY, so everything using
+// them can be drawn with a single bind. vertices pick their layer (see MeshBatch).
+// each layer starts out as its solid fallback color; images are read on the
+// AsyncTextureLoader workers and swapped in with their mip chains. the array
+// is BC3 when the driver has S3TC, else RGBA8; layers come from the texbake
+// variants when those hold a level of the layer size, else they are decoded,
+// scaled and (for BC3) compressed on the worker. the layer size is capped by
+// the texture budget, bytes included.
+class MaterialArray
+{
+public:
+    MaterialArray() = default;
+    ~MaterialArray() { Free(); }
+    MaterialArray(const MaterialArray &) = delete;
+    MaterialArray &operator=(const MaterialArray &) = delete;
+
+    // returns the layer index. an empty path makes a solid color layer.
+    int AddLayer(const std::string &path, const glm::vec3 &fallbackColor);
+
+    // creates the array; layerSize is rounded down to a power of two and
+    // capped by the texture budget
+    bool Build(int layerSize = 512, const TextureSettings &settings = {});
+    void Free();
+    // frees the array and forgets every layer
+    void Clear();
+
+    GLuint Id() const { return texture; }
+    int LayerCount() const { return static_cast<int>(layers.size()); }
+
+private:
+    struct Layer
+    {
+        std::string path;
+        glm::vec3 color;
+    };
+
+    void LoadLayer(int index);
+
+    std::vector<Layer> layers;
+    GLuint texture = 0;
+    int size = 0;
+    bool compressed = false;
+    GLenum format = 0;
+    // cleared by Free so late decodes don't touch a deleted array
+    std::shared_ptr<bool> alive;
+};
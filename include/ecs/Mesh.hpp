@@ -9,5 +9,13 @@ struct Mesh
     GLuint ebo = 0;
     int indexCount = 0;
     GLuint texture = 0;
+    // GL_TEXTURE_2D_ARRAY sampled with the per-vertex layer; takes precedence over texture
+    GLuint textureArray = 0;
+    // baked static lighting (Lightmap) read through the vertices' lightmap uv; replaces the main light
+    GLuint lightmap = 0;
     glm::vec3 color = glm::vec3(1.0f);
+    // local-space box around the vertices, for culling
+    bool hasBounds = false;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
 };
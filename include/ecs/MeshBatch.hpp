@@ -0,0 +1,37 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ecs/Mesh.hpp"
+#include "ecs/MeshLibrary.hpp"
+
+// merges transformed copies of CPU geometry into one static mesh. every
+// vertex carries the MaterialArray layer it samples, so the whole batch is a
+// single draw with a single texture bind.
+// vertex layout: pos(3) normal(3) uv(2) layer(1) lightmap uv(2) occlusion(1)
+class MeshBatch
+{
+public:
+    static constexpr int extraFloats = 4;
+
+    // baked per-vertex data
+    struct Extras
+    {
+        glm::vec2 lightmapUV{0.0f}; // see Lightmap::AtlasUV
+        float occlusion = 1.0f;     // see VoxelAO
+    };
+    // called with each transformed vertex
+    using ExtrasFn = std::function<Extras(const glm::vec3 &position, const glm::vec3 &normal)>;
+
+    // without extras the vertices get the Extras defaults
+    void Add(const MeshData &data, const glm::mat4 &transform, int layer, const ExtrasFn &extras = {});
+    bool Empty() const { return indices.empty(); }
+
+    // the result is not shared; delete it with MeshLibrary::Free
+    Mesh Upload(const std::string &label) const;
+
+private:
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+};
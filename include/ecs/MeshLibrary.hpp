@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "ecs/Mesh.hpp"
+
+// interleaved pos(3) normal(3) uv(2) geometry on the CPU
+struct MeshData
+{
+    static constexpr int floatsPerVertex = 8;
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    void Push(float x, float y, float z, float nx, float ny, float nz, float u, float v)
+    {
+        vertices.insert(vertices.end(), {x, y, z, nx, ny, nz, u, v});
+    }
+    unsigned int VertexCount() const { return static_cast<unsigned int>(vertices.size() / floatsPerVertex); }
+};
+
+// shared procedural primitives. meshes are keyed by primitive type and
+// parameters, so asking for the same cube twice hands back the same GL buffers.
+// every Cube/Plane/Wave/Sphere call takes a reference; call Release once per call.
+class MeshLibrary
+{
+public:
+    static Mesh Cube(float size = 1.0f);
+    static Mesh Plane(float width, float depth, float repeatX = 1.0f, float repeatZ = 1.0f);
+    static Mesh Wave(float tileSize, int segments = 24);
+    static Mesh Sphere(int lat = 6, int lon = 6);
+
+    // the same primitives as plain geometry, e.g. for merging into a MeshBatch
+    static MeshData CubeData(float size = 1.0f);
+    static MeshData PlaneData(float width, float depth, float repeatX = 1.0f, float repeatZ = 1.0f);
+    static MeshData WaveData(float tileSize, int segments = 24);
+
+    // drops one reference. unreferenced meshes stay resident so a map reload
+    // can pick them up again; GpuResources evicts them under budget pressure.
+    static void Release(const Mesh &mesh);
+    // deletes every unreferenced mesh now
+    static void Trim();
+
+    // upload interleaved pos(3) normal(3) uv(2) vertices into a fresh VAO/VBO/EBO.
+    // extraFloats per-vertex scalars may follow the uv; they bind to attribute
+    // locations 3, 4, ... the result is not shared or refcounted; delete it with Free.
+    static Mesh Upload(const std::vector<float> &vertices, const std::vector<unsigned int> &indices,
+                       const std::string &label = "mesh", int extraFloats = 0);
+    static void Free(const Mesh &mesh);
+
+    // back faces are culled, so every triangle must be counter-clockwise seen
+    // from the side its vertex normals point to. reverses the ones that are not
+    // and returns how many it reversed; degenerate triangles and triangles
+    // without normals are left alone. stride is in floats per vertex.
+    static size_t NormalizeWinding(const std::vector<float> &vertices, std::vector<unsigned int> &indices,
+                                   int stride = MeshData::floatsPerVertex);
+
+    // bytes of vertex + index data currently held by shared meshes (including unreferenced ones)
+    static size_t GpuBytes();
+    static size_t MeshCount();
+};
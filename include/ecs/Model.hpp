@@ -5,4 +5,6 @@
 struct Model
 {
     static Mesh LoadFromOBJ(const std::string &path);
+    // deletes the buffers of a mesh returned by LoadFromOBJ and releases its texture
+    static void Free(const Mesh &mesh);
 };
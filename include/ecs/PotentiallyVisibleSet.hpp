@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ecs/Lightmap.hpp"
+
+struct PvsSettings
+{
+    // cells farther apart than this never see each other (the far plane)
+    float maxDistance = 100.0f;
+    // rays are cast between n x n points spread over each cell of a pair
+    int samplesPerAxis = 4;
+};
+
+// which cells of the tile map can possibly be seen from each walkable cell,
+// precomputed because the map is a fixed grid. walls are full-height
+// columns, so visibility is solved top-down: a pair of cells sees each
+// other if any ray between points of the two crosses no wall. when the
+// scene wraps rows, a cell also counts as visible if any repeated copy of
+// it is. source cells are spread over worker threads and the result is
+// cached on disk keyed by the map and the settings.
+// positions are segment-local, in the scene's x/z; y is ignored.
+class PotentiallyVisibleSet
+{
+public:
+    // loads the cached sets or bakes and stores them. workers = 0 uses every core.
+    bool Bake(const LightmapScene &scene, const PvsSettings &settings, const std::string &cacheDir = "cache/pvs",
+              int workers = 0);
+    void Clear();
+
+    bool Empty() const { return bits.empty(); }
+    // cell index (row * cols + col), rows wrapped if the scene wraps;
+    // -1 outside the map
+    int CellAt(const glm::vec3 &local) const;
+    // unknown or solid source cells see everything
+    bool IsVisible(int fromCell, int toCell) const;
+    // any cell under the box's x/z footprint; parts outside the map count as visible
+    bool IsVisible(int fromCell, const glm::vec3 &localMin, const glm::vec3 &localMax) const;
+    // bitset of one walkable cell, CellCount() bits; null for other cells
+    const uint64_t *Row(int fromCell) const;
+
+    int CellCount() const { return rows * cols; }
+    size_t VisiblePairs() const;
+    bool FromCache() const { return cached; }
+
+private:
+    uint64_t Key(const PvsSettings &settings) const;
+    // workers claim source cells until none are left; each writes only its own row
+    void BakeCells(const PvsSettings &settings, std::atomic<int> &nextCell);
+    bool RayClear(const glm::vec2 &from, const glm::vec2 &to) const;
+
+    LightmapScene scene;
+    int rows = 0, cols = 0;
+    size_t words = 0; // per row
+    std::vector<uint64_t> bits;
+    bool cached = false;
+};
@@ -1,23 +1,141 @@
 #pragma once
 #include "ecs/System.hpp"
-#include "ecs/Shader.hpp"
+#include "ecs/ShaderVariants.hpp"
 #include "ecs/Transform.hpp"
 #include "ecs/Mesh.hpp"
 #include "ecs/Camera.hpp"
+#include "renderer/GpuResources.hpp"
+#include "renderer/RenderGraph.hpp"
+#include "renderer/LightClusters.hpp"
+#include "renderer/ShadowMap.hpp"
+#include "renderer/SoftwareOcclusion.hpp"
+#include "renderer/OcclusionQueries.hpp"
+#include "ecs/WorldSegment.hpp"
+#include "ecs/PotentiallyVisibleSet.hpp"
 #include <glm/gtc/matrix_transform.hpp>
+#include <vector>
 class SkyboxSystem;
 
 class RenderSystem : public System
 {
-    Shader *shader;
+    ShaderVariants shaders;
     glm::mat4 view, proj;
 
 public:
     RenderSystem();
+    // Update collects the frame's draws; the passes added here submit them
+    // when the graph executes. color and depth are the window's buffers.
+    void AddPasses(RenderGraph &graph, RenderGraph::Resource color, RenderGraph::Resource depth);
     void Update(Registry &registry, float dt) override;
     void SetSkybox(SkyboxSystem *s) { skybox = s; }
     void Cleanup();
 
+    size_t VariantCount() const { return shaders.Count(); }
+    const LightClusters &Clusters() const { return clusters; }
+    const ShadowMap &Shadows() const { return shadows; }
+    const SoftwareOcclusion &Occlusion() const { return occlusion; }
+    // draws skipped last frame because the camera's cell cannot see them
+    size_t PvsCulled() const { return pvsCulled; }
+    const OcclusionQueries &Queries() const { return queries; }
+
 private:
+    struct DrawItem
+    {
+        uint32_t features = 0;
+        const Mesh *mesh = nullptr;
+        glm::mat4 model{1.0f};
+        glm::mat3 normal{1.0f};
+        glm::vec3 color{1.0f};
+        bool instanceable = true;
+        // occlusion query the draw is conditioned on, 0 for none
+        GLuint condition = 0;
+        // view-space distance along the camera axis, and its sort bucket
+        float depth = 0.0f;
+        int bucket = 0;
+    };
+
+    struct FrameUniforms
+    {
+        glm::mat4 view{1.0f};
+        glm::mat4 proj{1.0f};
+        glm::vec3 lightPos{0.0f};
+        glm::vec3 lightColor{1.0f};
+        float lightIntensity = 1.0f;
+        glm::vec3 viewPos{0.0f};
+        // pixels per froxel tile
+        float tileWidth = 1.0f, tileHeight = 1.0f;
+        // FragPos to world space, for the shadow lookups
+        glm::mat4 toWorld{1.0f};
+        glm::mat4 staticShadowMatrix{1.0f};
+        glm::mat4 dynamicShadowMatrix{1.0f};
+        bool staticShadows = false;
+        bool dynamicShadows = false;
+        // z of a world segment's origin and the segment length
+        float segmentPhase = 0.0f;
+        float segmentPeriod = 0.0f;
+    };
+
+    // false if the baked cell visibility rules the mesh out
+    bool PvsVisible(const Mesh &mesh, const glm::mat4 &model);
+    void MakeDrawItem(Registry &registry, Entity e, const Mesh *mesh, const glm::mat4 &model, DrawItem &item) const;
+    void CollectDraws(Registry &registry);
+    void CollectLights(Registry &registry, float aspect);
+    void SubmitDraws(const std::vector<DrawItem> &items, const FrameUniforms &frame, bool depthOnly);
+    void DrawShadows();
+    void DrawDepthPrepass();
+    void DrawOcclusionQueries();
+    // queries the draw's bounds this frame and conditions it on last frame's query
+    void TrackQuery(Entity e, const Mesh &mesh, DrawItem &item);
+    void DrawOpaque();
+    void DrawSkybox();
+    void DrawOverlay();
+    void ApplyFrameUniforms(const Shader &shader, const FrameUniforms &frame) const;
+    void DrawInstanced(const DrawItem *items, size_t count);
+
     SkyboxSystem *skybox = nullptr;
+    RenderGraph *graph = nullptr;
+    FrameUniforms frame;
+    // reused every frame to avoid reallocating
+    std::vector<DrawItem> draws;
+    // FirstPerson meshes, drawn in view space by the overlay pass
+    std::vector<DrawItem> overlayDraws;
+    std::vector<Entity> overlayEntities;
+    FrameUniforms overlayFrame;
+    // point lights binned into froxels on units 2-4
+    LightClusters clusters;
+    std::vector<PointLight> pointLights;
+    // static world in a cached map, everything else that moves in a per-frame one
+    ShadowMap shadows;
+    // walls rasterized on the CPU; draws they hide are dropped before submission
+    SoftwareOcclusion occlusion;
+    // the segments' cell visibility and where the camera stands in it; -1 when unused
+    const PotentiallyVisibleSet *pvs = nullptr;
+    int cameraCell = -1;
+    glm::vec3 pvsOrigin{0.0f};
+    float wallTop = 0.0f;
+    size_t pvsCulled = 0;
+    // segments and large batches, drawn only if last frame's bounding box query passed
+    struct QueryTarget
+    {
+        Entity entity;
+        glm::vec3 boundsMin, boundsMax;
+    };
+    OcclusionQueries queries;
+    std::vector<QueryTarget> queryTargets;
+    Mesh proxyBox;
+    std::vector<DrawItem> shadowCasters;
+    const Mesh *segmentMesh = nullptr;
+    GLuint segmentVao = 0;
+    WorldSegment segment;
+    float segmentPhase = 0.0f;
+    glm::vec3 toLight{0.0f};
+    // per-instance vertex data at attribute locations 8-14
+    struct InstanceData
+    {
+        glm::mat4 model;
+        glm::mat3 normal;
+    };
+    std::vector<InstanceData> instanceData;
+    GpuHandle instanceBuffer;
+    size_t instanceCapacity = 0;
 };
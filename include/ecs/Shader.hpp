@@ -1,13 +1,47 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <glad/glad.h>
+#include <glm/glm.hpp>
 
+// constructing a Shader only submits the compile and link. with
+// KHR_parallel_shader_compile the driver works on it in the background;
+// Poll checks without blocking, and Use (or Wait) blocks until it is done.
 class Shader
 {
 public:
     GLuint id = 0;
-    Shader(const char *vertexSrc, const char *fragmentSrc);
-    void Use() const { glUseProgram(id); }
+    Shader(const char *vertexSrc, const char *fragmentSrc, const std::string &label = "shader program");
+    // waits for the link, then binds the program
+    void Use();
+    // true once linking has finished (successfully or not); never blocks
+    // when parallel compilation is available
+    bool Poll();
+    void Wait();
+    // valid after Poll returned true or Wait
+    bool Linked() const { return linked; }
+
+    // uniform locations are looked up once per name; -1 (inactive) is cached too
+    GLint Uniform(const std::string &name) const;
     void SetMat4(const std::string &name, const float *value) const;
+    void SetMat3(const std::string &name, const glm::mat3 &value) const;
+    void SetVec3(const std::string &name, const glm::vec3 &value) const;
+    void SetFloat(const std::string &name, float value) const;
+    void SetInt(const std::string &name, int value) const;
     ~Shader();
+
+    // needs the GL context. enables KHR_parallel_shader_compile when present.
+    static void InitParallelCompile();
+    static bool ParallelCompile();
+
+private:
+    void Finish();
+
+    GLuint vs = 0;
+    GLuint fs = 0;
+    uint64_t cacheKey = 0;
+    bool pending = false;
+    bool linked = false;
+    mutable std::unordered_map<std::string, GLint> uniforms;
 };
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ecs/Shader.hpp"
+
+// feature bits; each one becomes a #define of the same name in both stages
+enum ShaderFeature : uint32_t
+{
+    FeatureTextured = 1u << 0,
+    FeatureTextureArray = 1u << 1,
+    FeatureEmissive = 1u << 2,
+    FeatureInstanced = 1u << 3,
+    FeatureLightmapped = 1u << 4,
+};
+
+// one vertex/fragment source pair compiled once per feature set. variants
+// are built on first use and cached by their feature mask.
+class ShaderVariants
+{
+public:
+    // reads both sources; nothing is compiled yet
+    bool Load(const std::string &vertexPath, const std::string &fragmentPath);
+    bool Loaded() const { return !vertexSrc.empty() && !fragmentSrc.empty(); }
+
+    // nullptr if the sources are missing or the variant failed to link.
+    // waits if the variant is still compiling, and submits it if it was never requested.
+    Shader *Get(uint32_t features);
+
+    // submits every listed variant without waiting, so they compile side by side
+    void Prewarm(const std::vector<uint32_t> &featureSets);
+    // finishes variants whose compile is done; never blocks with parallel compile
+    void Poll();
+    size_t Pending() const;
+
+    // "#define TEXTURED\n..." for the bits in features
+    static std::string Defines(uint32_t features);
+    // inserts defines right after the #version line (or at the top if there is none)
+    static std::string Inject(const std::string &source, const std::string &defines);
+
+    size_t Count() const { return variants.size(); }
+    void Clear() { variants.clear(); }
+
+private:
+    Shader *Submit(uint32_t features);
+    // drops a variant that failed to link; the nullptr entry stops retries
+    Shader *Check(std::unordered_map<uint32_t, std::unique_ptr<Shader>>::iterator it);
+
+    std::string vertexSrc;
+    std::string fragmentSrc;
+    std::string name;
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>> variants;
+};
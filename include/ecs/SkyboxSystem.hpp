@@ -1,26 +1,42 @@
 #pragma once
 #include "ecs/System.hpp"
 #include "ecs/Shader.hpp"
+#include "ecs/Texture.hpp"
+#include "renderer/GpuResources.hpp"
 #include <glad/glad.h>
+#include <glm/glm.hpp>
 #include <string>
+#include <vector>
 
 class SkyboxSystem : public System
 {
-    GLuint cubemap = 0;
-    GLuint vao = 0, vbo = 0;
+    GpuHandle cubemap;
+    GpuHandle vao, vbo;
     Shader *shader = nullptr;
     int faceW = 0;
     int faceH = 0;
 
+    bool UploadCrossImage(const DecodedImage &image);
+    bool UploadBaked(const std::vector<char> &bytes, const std::string &path);
+
 public:
     SkyboxSystem();
     ~SkyboxSystem();
 
     bool LoadFromCrossImage(const std::string &path);
+    // decodes on an AsyncTextureLoader worker; the skybox appears once uploaded.
+    // with bakedPath set, an up-to-date baked cubemap is loaded instead of the
+    // cross image, and one is written after decoding the cross image otherwise.
+    void LoadFromCrossImageAsync(const std::string &path, const std::string &bakedPath = "");
+
+    // writes the six faces pre-split with full mip chains
+    static bool BakeCrossImage(const DecodedImage &cross, const std::string &outPath);
 
     void Update(Registry &registry, float dt) override;
+    // draws with the renderer's camera; the translation of view is ignored
+    void Draw(const glm::mat4 &view, const glm::mat4 &proj);
     void Cleanup();
-    bool IsLoaded() const { return cubemap != 0; }
+    bool IsLoaded() const { return static_cast<bool>(cubemap); }
 
     int GetFaceWidth() const;
     int GetFaceHeight() const;
@@ -1,11 +1,74 @@
 #pragma once
+#include <cstddef>
 #include <string>
+#include <vector>
 #include <glad/glad.h>
+#include "ecs/ImageUtils.hpp"
+#include "ecs/Ktx.hpp"
+
+// how a texture is sampled and stored; part of the TextureCache key
+struct TextureSettings
+{
+    GLenum wrap = GL_REPEAT;
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+    bool srgb = true;
+
+    bool operator==(const TextureSettings &o) const
+    {
+        return wrap == o.wrap && minFilter == o.minFilter && magFilter == o.magFilter && srgb == o.srgb;
+    }
+};
+
+// caps texture memory on lower-end machines and headless bench runs.
+// images over the budget are box-filtered down on load; baked mip chains
+// skip their top levels instead. set before loading textures.
+struct TextureBudget
+{
+    int maxDimension = 0;     // longest side, 0 = unlimited
+    size_t maxTotalBytes = 0; // across all textures, 0 = unlimited
+};
 
 class Texture
 {
 public:
-    // returns 0 on failure.
-    static GLuint Load(const std::string &path);
+    // returns 0 on failure. prefers a baked .ktx next to the image when one is current.
+    static GLuint Load(const std::string &path, const TextureSettings &settings = {});
     static void Free(GLuint id);
+
+    // safe to call from any thread. flip puts the bottom row first, as GL expects.
+    static bool Decode(const std::string &path, bool flip, DecodedImage &out);
+    // (re)specifies tex from decoded pixels and applies the sampler settings
+    static void Upload(GLuint tex, const DecodedImage &image, const TextureSettings &settings);
+    // same, from raw tightly packed rows. pixels is an offset when a
+    // GL_PIXEL_UNPACK_BUFFER is bound.
+    static void Upload(GLuint tex, int width, int height, int channels, const void *pixels, const TextureSettings &settings);
+    // level 0 storage and sampler settings only, contents undefined and no
+    // mipmaps; the caller fills it (e.g. from a PBO) and generates them.
+    // no GL_PIXEL_UNPACK_BUFFER may be bound.
+    static void Allocate(GLuint tex, int width, int height, int channels, const TextureSettings &settings);
+    // uploads every stored mip level as-is; no glGenerateMipmap
+    static void Upload(GLuint tex, const Ktx::Image &image, const TextureSettings &settings);
+
+    // the baked variant of path to load instead, or "" to decode the image.
+    // the compressed variant is only picked when the driver has S3TC.
+    // main thread only (needs the GL context).
+    static std::string FindBaked(const std::string &path);
+    static bool SupportsS3tc();
+
+    // main thread only; workers get a copy taken when their job is submitted
+    static void SetBudget(const TextureBudget &budget);
+    static const TextureBudget &GetBudget();
+    // bytes a new texture may still use under maxTotalBytes. main thread only.
+    static size_t AvailableBytes();
+    // halves image until it fits limits.maxDimension and availableBytes. safe on
+    // any thread given copies of both. returns the number of levels dropped.
+    static int FitToBudget(DecodedImage &image, const TextureBudget &limits, size_t availableBytes);
+    // estimated VRAM for a w x h texture with its mip chain
+    static size_t EstimateBytes(int width, int height, int channels);
+
+    // 1x1 grey texture, bound until the real image arrives
+    static GLuint CreatePlaceholder(const std::string &label, const TextureSettings &settings);
+    // respecifies tex as a 2x2 magenta/black checker, for images that failed to load
+    static void UploadMissing(GLuint tex, const TextureSettings &settings);
 };
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include "ecs/Texture.hpp"
+
+// shares textures loaded from disk. keyed by canonical path plus settings, so
+// "data/grass.jpg" and "./data/../data/grass.jpg" decode and upload once.
+// every Acquire takes a reference; call Release once per Acquire.
+class TextureCache
+{
+public:
+    struct Stats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t failures = 0; // misses whose load failed; later requests hit the cached 0 (or,
+                             // for a failed async decode, the missing-image checker)
+        size_t textures = 0; // resident textures, referenced or not
+    };
+
+    // returns 0 when the image could not be loaded. with the async loader a decode
+    // failure shows up later: the texture turns into Texture::UploadMissing's checker.
+    static GLuint Acquire(const std::string &path, const TextureSettings &settings = {});
+
+    // unreferenced textures stay resident and are evicted by GpuResources under budget pressure
+    static void Release(GLuint tex);
+    // deletes every unreferenced texture now
+    static void Trim();
+
+    static Stats GetStats();
+};
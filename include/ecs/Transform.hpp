@@ -1,4 +1,6 @@
 #pragma once
+#include <algorithm>
+#include <cmath>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -18,4 +20,22 @@ struct Transform
         model = glm::scale(model, scale);
         return model;
     }
+
+    // matrix that carries normals through model: the inverse-transpose of its
+    // upper 3x3. for rotation with uniform scale that is the 3x3 itself up to a
+    // factor, which the shader's normalize removes, so the inverse is skipped.
+    static glm::mat3 NormalMatrix(const glm::mat4 &model)
+    {
+        glm::mat3 m(model);
+        float xx = glm::dot(m[0], m[0]);
+        float yy = glm::dot(m[1], m[1]);
+        float zz = glm::dot(m[2], m[2]);
+        float eps = 1e-4f * std::max(xx, std::max(yy, zz));
+        bool uniformScale = std::abs(xx - yy) <= eps && std::abs(xx - zz) <= eps &&
+                            std::abs(glm::dot(m[0], m[1])) <= eps && std::abs(glm::dot(m[0], m[2])) <= eps &&
+                            std::abs(glm::dot(m[1], m[2])) <= eps;
+        if (uniformScale)
+            return m;
+        return glm::transpose(glm::inverse(m));
+    }
 };
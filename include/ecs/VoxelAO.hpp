@@ -0,0 +1,17 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "ecs/Lightmap.hpp"
+
+// voxel-style ambient occlusion for tile-grid geometry. the ground below
+// y = 0 and the wall columns are solid cells; a vertex is darkened by the
+// solid cells around it on the lit side of its face, as in block games.
+// 1 is fully open, lower values are occluded.
+namespace VoxelAO
+{
+    // p is a corner of an axis-aligned face whose center lies toward faceCenter
+    float Corner(const LightmapScene &grid, const glm::vec3 &p, const glm::vec3 &normal, const glm::vec3 &faceCenter);
+    // any point of an up-facing surface on the ground tile centered at
+    // tileCenter: the tile's corner values blended bilinearly, so finely
+    // tessellated tiles shade smoothly
+    float Ground(const LightmapScene &grid, const glm::vec3 &p, const glm::vec3 &tileCenter);
+}
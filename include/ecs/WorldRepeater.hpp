@@ -2,6 +2,10 @@
 
 #include "ecs/System.hpp"
 #include "ecs/Registry.hpp"
+#include "ecs/Mesh.hpp"
+#include "ecs/MaterialArray.hpp"
+#include "ecs/Lightmap.hpp"
+#include "ecs/PotentiallyVisibleSet.hpp"
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
@@ -18,6 +22,13 @@ public:
     void Cleanup();
 
 private:
+    // charts for the ground and every wall face, packed, baked (or loaded
+    // from the cache) and uploaded before the segment mesh is built
+    // also fills grid, which VoxelAO reads while the segment is built
+    void BakeLighting(Registry &registry, const std::vector<std::string> &lines, size_t rows, size_t cols);
+    // sun direction and color from the main light, as the bake sees it
+    static void SunFromMainLight(Registry &registry, LightmapSettings &settings);
+
     std::string path;
     int segmentRepeats = 0;
     float speed = 0.0f;
@@ -29,4 +40,16 @@ private:
     float mapDepth = 0.0f;
     std::vector<std::vector<glm::vec3>> copiesInitialPositions;
     double totalScroll = 0.0;
+    // one batched mesh shared by every segment, textured from the material array
+    Mesh segmentMesh;
+    MaterialArray materials;
+    // static lighting of one segment; every copy shares it
+    Lightmap lightmap;
+    LightmapScene grid;
+    // what lightmap was last baked (or is being rebaked) with
+    LightmapSettings lightSettings;
+    int groundChart = -1;
+    std::vector<int> wallCharts; // six per wall, in wallCenters order
+    // which cells see which, baked from grid; every copy shares it
+    PotentiallyVisibleSet pvs;
 };
@@ -0,0 +1,26 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+class PotentiallyVisibleSet;
+
+// one copy of the repeating static world. copies share their mesh and sit
+// period apart along z, so anything baked in segment-local space applies to all.
+// copies are only ever translated, never rotated or scaled.
+struct WorldSegment
+{
+    struct Box
+    {
+        glm::vec3 min{0.0f};
+        glm::vec3 max{0.0f};
+    };
+
+    // segment-local bounds of the geometry
+    glm::vec3 boundsMin{0.0f};
+    glm::vec3 boundsMax{0.0f};
+    float period = 0.0f;
+    // segment-local solid boxes that hide what is behind them (walls)
+    std::vector<Box> occluders;
+    // cell-to-cell visibility of the map, owned by WorldRepeater; may be empty
+    const PotentiallyVisibleSet *pvs = nullptr;
+};
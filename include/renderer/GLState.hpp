@@ -0,0 +1,57 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include "renderer/GpuResources.hpp"
+
+// shadow copy of the GL state the renderer touches. every setter compares
+// against what it last issued and drops the call when nothing changes.
+// state is never read back from GL; anything that changes GL state behind
+// our back (ImGui's backend) must be followed by Invalidate().
+class GLState
+{
+public:
+    struct Viewport
+    {
+        int x = 0, y = 0, width = 0, height = 0;
+    };
+
+    struct Stats
+    {
+        size_t issued = 0;
+        size_t filtered = 0;
+    };
+
+    static void UseProgram(GLuint program);
+    static void BindVertexArray(GLuint vao);
+    // GL_FRAMEBUFFER; 0 is the window
+    static void BindFramebuffer(GLuint framebuffer);
+    // binds to GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP or GL_TEXTURE_BUFFER on a unit,
+    // switching the active unit only when it differs
+    static void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    // GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_FRAMEBUFFER_SRGB and GL_SCISSOR_TEST
+    // are tracked; other caps are passed straight through
+    static void Enable(GLenum cap, bool on = true);
+    static void Disable(GLenum cap) { Enable(cap, false); }
+    static void DepthFunc(GLenum func);
+    static void DepthMask(bool write);
+    static void BlendFunc(GLenum src, GLenum dst);
+    static void CullFace(GLenum face);
+    static void FrontFace(GLenum mode);
+    static void UnpackAlignment(int alignment);
+
+    static void SetViewport(int x, int y, int width, int height);
+    // last viewport we set; nothing is queried from GL
+    static const Viewport &GetViewport();
+
+    // forget everything; the next call of each setter is issued unconditionally
+    static void Invalidate();
+    // a GL object was deleted. GL unbinds deleted textures and VAOs from the
+    // current context, so mirror that instead of filtering a rebind of a reused name.
+    static void Forget(GpuKind kind, GLuint id);
+
+    // counts since the last EndFrame, and the totals of the frame before it
+    static Stats GetStats();
+    static Stats LastFrame();
+    static void EndFrame();
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+
+enum class GpuKind
+{
+    Buffer,
+    VertexArray,
+    Texture,
+    Program,
+    Framebuffer,
+    Query,
+    Count
+};
+
+// tracks every GL object we create, with a byte estimate per object.
+// reloadable objects (cached assets nobody references right now) may be
+// evicted least-recently-used first once the budget is exceeded.
+class GpuResources
+{
+public:
+    static GLuint CreateBuffer(const std::string &label);
+    static GLuint CreateVertexArray(const std::string &label);
+    static GLuint CreateTexture(const std::string &label);
+    static GLuint CreateProgram(const std::string &label);
+    static GLuint CreateFramebuffer(const std::string &label);
+    static GLuint CreateQuery(const std::string &label);
+
+    // deletes the GL object and stops tracking it. 0 is ignored.
+    static void Destroy(GpuKind kind, GLuint id);
+
+    static void SetBytes(GpuKind kind, GLuint id, size_t bytes);
+    static void Touch(GpuKind kind, GLuint id);
+
+    // evict must free the object (through Destroy) and return true, or return
+    // false if it is in use again. pass an empty function to clear.
+    // eviction only ever frees what a refcounted owner has let go of: MeshLibrary
+    // primitives, and TextureCache textures; nothing else is reloadable.
+    static void SetReloadable(GpuKind kind, GLuint id, std::function<bool()> evict);
+
+    // 0 disables the budget
+    static void SetBudget(size_t bytes);
+    static size_t GetBudget();
+    static void EnforceBudget();
+
+    static size_t Bytes(GpuKind kind);
+    static size_t Count(GpuKind kind);
+    static size_t TotalBytes();
+    static size_t PeakBytes();
+
+    // visits every live object of one kind, largest first
+    static void ForEach(GpuKind kind, const std::function<void(GLuint id, const std::string &label, size_t bytes)> &fn);
+
+    // usage per category, followed by every object still alive
+    static void Report(std::ostream &out);
+};
+
+// owns a single GL object; deleting the handle deletes the object
+class GpuHandle
+{
+    GpuKind kind = GpuKind::Buffer;
+    GLuint id = 0;
+
+public:
+    GpuHandle() = default;
+    GpuHandle(GpuKind k, GLuint name) : kind(k), id(name) {}
+    ~GpuHandle() { Reset(); }
+
+    GpuHandle(const GpuHandle &) = delete;
+    GpuHandle &operator=(const GpuHandle &) = delete;
+    GpuHandle(GpuHandle &&o) noexcept : kind(o.kind), id(o.id) { o.id = 0; }
+    GpuHandle &operator=(GpuHandle &&o) noexcept
+    {
+        if (this != &o)
+        {
+            Reset();
+            kind = o.kind;
+            id = o.id;
+            o.id = 0;
+        }
+        return *this;
+    }
+
+    GLuint Get() const { return id; }
+    explicit operator bool() const { return id != 0; }
+
+    void Reset()
+    {
+        if (id)
+            GpuResources::Destroy(kind, id);
+        id = 0;
+    }
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "renderer/GpuResources.hpp"
+
+// view-space point light; color is premultiplied by intensity
+struct PointLight
+{
+    glm::vec3 position{0.0f};
+    float radius = 1.0f;
+    glm::vec3 color{1.0f};
+};
+
+// clustered forward lighting. the view frustum is cut into a grid of
+// froxels (screen tiles times exponential depth slices); every frame each
+// light is tested against the froxels its bounds overlap and the result is
+// uploaded as three buffer textures the fragment shader reads:
+//   lights   RGBA32F, two texels per light: position + radius, color
+//   grid     RG32UI, per froxel: first index, light count
+//   indices  R32UI, light indices grouped by froxel
+// so a fragment only loops over the lights that can reach it.
+class LightClusters
+{
+public:
+    static constexpr int tilesX = 16;
+    static constexpr int tilesY = 9;
+    static constexpr int slices = 24;
+    static constexpr int clusterCount = tilesX * tilesY * slices;
+    // lights past this are dropped, nearest first kept
+    static constexpr size_t maxLights = 256;
+
+    // bins lights for a symmetric perspective projection. froxel bounds
+    // are only rebuilt when the projection changes.
+    void Build(std::vector<PointLight> lights, float fovY, float aspect, float zNear, float zFar);
+    void Upload();
+    // binds lights, grid and indices to units first, first+1, first+2
+    void Bind(GLuint firstUnit) const;
+    void Free();
+
+    size_t LightCount() const { return lightCount; }
+    size_t IndexCount() const { return indices.size(); }
+    float Near() const { return zNear; }
+    float Far() const { return zFar; }
+
+private:
+    void BuildBounds();
+    void BinLight(uint32_t index, const PointLight &light, std::vector<uint32_t> &hits) const;
+
+    float fovY = 0.0f, aspect = 0.0f, zNear = 0.0f, zFar = 0.0f;
+
+    // froxel AABBs in view space, structure-of-arrays so four froxels of a
+    // row are tested against a light at once
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    size_t lightCount = 0;
+    std::vector<float> lightData;
+    std::vector<uint32_t> grid;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> pairs; // scratch: cluster << 16 | light
+
+    GpuHandle buffers[3];
+    GpuHandle textures[3];
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+// GPU occlusion culling with one frame of latency. each tracked object gets
+// a GL_ANY_SAMPLES_PASSED query around a draw of its bounding box (color
+// and depth writes off) after the opaque pass; next frame the object is
+// drawn under glBeginConditionalRender on that query. the GPU runs frames in
+// order, so last frame's result is ready by then and the CPU never waits on
+// it. query objects come from a pool and are reused.
+class OcclusionQueries
+{
+public:
+    struct Stats
+    {
+        size_t tracked = 0;     // boxes queried this frame
+        size_t conditional = 0; // draws conditioned on last frame's queries
+        // results of the queries retired this frame, read only if already available
+        size_t visible = 0;
+        size_t occluded = 0;
+        size_t created = 0; // query objects in the pool, in use or not
+    };
+
+    // the queries issued last frame become this frame's conditions
+    void BeginFrame();
+    // query to condition key's draw on; 0 if key was not queried last frame
+    GLuint Condition(uint64_t key);
+    // around one bounding box draw for key
+    void Begin(uint64_t key);
+    void End();
+    void Free();
+
+    const Stats &GetStats() const { return stats; }
+
+private:
+    struct Slot
+    {
+        GLuint previous = 0; // issued last frame, conditions this one
+        GLuint current = 0;  // issued this frame
+    };
+
+    GLuint Acquire();
+
+    std::unordered_map<uint64_t, Slot> slots;
+    // free queries, oldest first, so a name is not reused right after a conditional draw read it
+    std::deque<GLuint> pool;
+    std::vector<GLuint> retired; // last frame's conditions, back to the pool next frame
+    std::vector<GLuint> created;
+    Stats stats;
+};
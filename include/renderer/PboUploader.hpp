@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include "ecs/Texture.hpp"
+
+// streams texture uploads through a ring of pixel buffer objects. decoded
+// pixels are copied into a mapped PBO on a worker thread, then
+// glTexSubImage2D sources the PBO so the driver can DMA without blocking us.
+// each slot is fenced and only reused once the GPU has consumed it.
+class PboUploader
+{
+public:
+    static void Init(int slots = 4);
+    static void Shutdown();
+    static bool IsActive();
+
+    // queue an upload of image into tex; the image is kept until the copy is done
+    static void Upload(GLuint tex, DecodedImage &&image, const TextureSettings &settings);
+    // drop queued or in-flight uploads into tex (it is being deleted)
+    static void Cancel(GLuint tex);
+
+    // start queued uploads on slots whose fence has signalled. call once per frame.
+    static void Update();
+
+    static size_t Pending();
+};
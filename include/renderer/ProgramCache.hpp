@@ -0,0 +1,35 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// on-disk cache of linked program binaries (GL 4.1 / ARB_get_program_binary).
+// entries are keyed by a hash of the final shader sources (defines included)
+// and the driver's vendor/renderer/version strings, so a driver update or a
+// source change simply misses. without driver support every call is a no-op.
+class ProgramCache
+{
+public:
+    // needs the GL context; call once after the loader is initialised
+    static void Init(const std::string &directory = "cache/shaders");
+    static bool Available();
+
+    static uint64_t Key(const char *vertexSrc, const char *fragmentSrc);
+
+    // call before linking so the driver keeps a retrievable binary
+    static void PrepareForLink(GLuint program);
+    // true if program was linked from the cache. a rejected binary is deleted
+    // and program can still be compiled from source as usual.
+    static bool Load(GLuint program, uint64_t key);
+    static void Store(GLuint program, uint64_t key);
+
+    struct Stats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t rejected = 0;
+        size_t stored = 0;
+    };
+    static Stats GetStats();
+};
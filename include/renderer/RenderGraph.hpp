@@ -0,0 +1,127 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// a frame as a list of passes that declare which resources they read and
+// write. Compile orders the passes by those dependencies, drops passes whose
+// results nobody consumes, and lets transient textures with disjoint
+// lifetimes share one GL texture. Execute runs the passes and times each one
+// on the CPU and, through timer queries read a few frames late, on the GPU.
+class RenderGraph
+{
+public:
+    using Resource = int;
+    static constexpr Resource None = -1;
+
+    // width/height of 0 follow the viewport
+    struct TextureDesc
+    {
+        int width = 0;
+        int height = 0;
+        GLenum internalFormat = GL_RGBA8;
+
+        bool operator==(const TextureDesc &o) const
+        {
+            return width == o.width && height == o.height && internalFormat == o.internalFormat;
+        }
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::vector<Resource> reads;
+        std::vector<Resource> writes;
+        std::function<void()> execute;
+        // kept even when nothing reads its outputs
+        bool sideEffects = false;
+    };
+
+    struct PassStats
+    {
+        std::string name;
+        bool culled = false;
+        // smoothed over recent frames; gpuMs stays 0 until results arrive
+        double cpuMs = 0.0;
+        double gpuMs = 0.0;
+    };
+
+    RenderGraph() = default;
+    ~RenderGraph() { Release(); }
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    // owned outside the graph, e.g. the window's color and depth buffers
+    Resource Import(const std::string &name);
+    // allocated by the graph, only valid while the passes using it run
+    Resource CreateTexture(const std::string &name, const TextureDesc &desc);
+    // results the frame must produce; passes feeding them are never culled
+    void MarkOutput(Resource resource);
+
+    void AddPass(Pass pass);
+    // disabled passes are left out as if never added
+    void SetEnabled(const std::string &name, bool enabled);
+    bool IsEnabled(const std::string &name) const;
+
+    // orders, culls and allocates. returns false on a dependency cycle.
+    // Execute compiles on its own after changes or a viewport resize.
+    bool Compile();
+    void Execute();
+
+    // GL texture behind a transient resource during Execute
+    GLuint Texture(Resource resource) const;
+
+    const std::vector<PassStats> &Stats() const { return stats; }
+    // transient resources and the GL textures backing them after aliasing
+    size_t TransientCount() const;
+    size_t PhysicalCount() const { return physical.size(); }
+
+    // frees every GL object the graph allocated
+    void Release();
+
+private:
+    struct ResourceInfo
+    {
+        std::string name;
+        bool imported = false;
+        bool output = false;
+        TextureDesc desc;
+        int physical = -1;
+    };
+
+    struct Physical
+    {
+        TextureDesc desc;
+        GLuint texture = 0;
+        int lastUse = -1;
+    };
+
+    // timer queries per pass, one per frame in flight
+    static constexpr int queryFrames = 3;
+
+    struct PassState
+    {
+        bool enabled = true;
+        GLuint framebuffer = 0;
+        GLuint queries[queryFrames] = {};
+        bool queryIssued[queryFrames] = {};
+    };
+
+    bool BuildOrder();
+    void Cull();
+    void Allocate(int viewportWidth, int viewportHeight);
+    void BindTargets(size_t pass);
+
+    std::vector<ResourceInfo> resources;
+    std::vector<Pass> passes;
+    std::vector<PassState> passState;
+    std::vector<PassStats> stats;
+    std::vector<size_t> order; // indices into passes, culled ones excluded
+    std::vector<Physical> physical;
+    bool dirty = true;
+    int compiledWidth = -1, compiledHeight = -1;
+    uint64_t frame = 0;
+};
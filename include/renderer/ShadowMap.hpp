@@ -0,0 +1,66 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <functional>
+#include "renderer/GpuResources.hpp"
+
+// directional shadows in two layers.
+//   static: the repeating world segment in segment-local space. every copy
+//     is the same geometry, so one map serves all of them; it is rendered
+//     again only when the light direction or the segment changes, not as
+//     segments scroll.
+//   dynamic: a small map around the camera with whatever moves, redrawn
+//     every frame there is something to draw.
+// both are depth textures sampled with hardware comparison (sampler2DShadow).
+class ShadowMap
+{
+public:
+    static constexpr int staticSize = 2048;
+    static constexpr int dynamicSize = 1024;
+
+    // fills the bound depth target using the given light view-projection
+    using DrawFn = std::function<void(const glm::mat4 &view, const glm::mat4 &proj)>;
+
+    // segment-local bounds of one copy, repeated every period along z.
+    // draw must render the copies at -period, 0 and +period so shadows
+    // reaching over a seam are kept. returns true if the map was redrawn.
+    bool UpdateStatic(const glm::vec3 &toLight, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float period,
+                      const DrawFn &draw);
+    // radius around focus in world space; the box is snapped to whole texels
+    // so it does not shimmer as the camera moves
+    void UpdateDynamic(const glm::vec3 &toLight, const glm::vec3 &focus, float radius, const DrawFn &draw);
+    // forgets the dynamic layer for this frame, e.g. with nothing to draw
+    void ClearDynamic() { dynamicValid = false; }
+    // the static geometry itself changed
+    void InvalidateStatic() { staticValid = false; }
+
+    void Bind(GLuint staticUnit, GLuint dynamicUnit) const;
+    void Free();
+
+    bool StaticValid() const { return staticValid; }
+    bool DynamicValid() const { return dynamicValid; }
+    // world or segment-local position to shadow texture coordinates and depth
+    const glm::mat4 &StaticMatrix() const { return staticMatrix; }
+    const glm::mat4 &DynamicMatrix() const { return dynamicMatrix; }
+    size_t StaticRenders() const { return staticRenders; }
+
+private:
+    struct Layer
+    {
+        GpuHandle texture;
+        GpuHandle framebuffer;
+    };
+
+    void Create(Layer &layer, int size, const char *label);
+    void Render(Layer &layer, int size, const glm::mat4 &view, const glm::mat4 &proj, const DrawFn &draw);
+
+    Layer staticLayer, dynamicLayer;
+    glm::mat4 staticMatrix{1.0f}, dynamicMatrix{1.0f};
+    bool staticValid = false, dynamicValid = false;
+
+    // what the static layer was drawn for
+    glm::vec3 staticLight{0.0f}, staticMin{0.0f}, staticMax{0.0f};
+    float staticPeriod = 0.0f;
+    size_t staticRenders = 0;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// occlusion culling on the CPU, in the spirit of masked occlusion culling.
+// each frame a few large opaque boxes (the map's walls) are rasterized into
+// a small depth buffer, then the bounds of everything else are tested
+// against it before their draws are submitted. it touches no GL, so it
+// works without a GPU.
+// depth is stored as 1 / w, which interpolates linearly across the screen:
+// bigger is nearer, 0 is empty.
+class SoftwareOcclusion
+{
+public:
+    static constexpr int width = 256;
+    static constexpr int height = 128;
+
+    struct Stats
+    {
+        size_t occluders = 0;
+        size_t tested = 0;
+        size_t culled = 0;
+    };
+
+    // clears the buffer for a new view-projection
+    void Begin(const glm::mat4 &viewProj);
+    // world-space box; its front faces are clipped to the near plane and drawn
+    void AddOccluder(const glm::vec3 &boxMin, const glm::vec3 &boxMax);
+    // local box moved by model. false only if it lies outside the view or
+    // wholly behind occluders; boxes crossing the near plane are visible.
+    bool IsVisible(const glm::vec3 &boxMin, const glm::vec3 &boxMax, const glm::mat4 &model = glm::mat4(1.0f));
+
+    const Stats &GetStats() const { return stats; }
+    // width * height, row 0 at the bottom of the screen
+    const std::vector<float> &Depth() const { return depth; }
+
+private:
+    // screen position and 1 / w
+    struct ScreenVertex
+    {
+        float x, y, invW;
+    };
+
+    void DrawQuad(const glm::vec4 clip[4]);
+    void DrawTriangle(const ScreenVertex &a, const ScreenVertex &b, const ScreenVertex &c);
+
+    glm::mat4 viewProj{1.0f};
+    std::vector<float> depth;
+    Stats stats;
+};
@@ -10,6 +10,8 @@ public:
 
   bool Init(const char *title, int width, int height);
   void BeginFrame();
+  // draws ImGui over the scene; runs as the render graph's UI pass
+  void RenderUI();
   void EndFrame();
   void Cleanup();
 };
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+
+// shared plumbing of the on-disk caches (lightmaps, visibility sets, program
+// binaries): FNV-1a keys, file names from keys, a magic/version/key header
+// that every reader checks, and writes that never leave a partial file.
+namespace BinaryCache
+{
+    constexpr uint64_t fnvOffset = 1469598103934665603ull;
+
+    uint64_t Fnv1a(const void *data, size_t size, uint64_t hash = fnvOffset);
+    // plain values only: the bytes of value are hashed, padding included
+    template <typename T>
+    uint64_t HashValue(const T &value, uint64_t hash)
+    {
+        return Fnv1a(&value, sizeof(value), hash);
+    }
+    // includes the terminator so "ab"+"c" and "a"+"bc" differ; null hashes as ""
+    uint64_t HashString(const char *s, uint64_t hash);
+
+    // directory/<key as 16 hex digits><extension>
+    std::string PathFor(const std::string &directory, uint64_t key, const char *extension);
+
+    template <typename T>
+    bool Read(std::istream &in, T &value)
+    {
+        return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+    }
+    template <typename T>
+    void Write(std::ostream &out, const T &value)
+    {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    // false if the file is missing, short or written by another format, version or key
+    bool ReadHeader(std::istream &in, const char (&magic)[4], uint32_t version, uint64_t key);
+    void WriteHeader(std::ostream &out, const char (&magic)[4], uint32_t version, uint64_t key);
+
+    // creates the directory, runs write on path + ".tmp" and renames it over
+    // path, so a crash mid-write leaves the old entry or none. false on failure.
+    bool WriteAtomic(const std::string &path, const std::function<void(std::ostream &)> &write);
+}
@@ -5,152 +5,11 @@
 #include <iostream>
 #include <glm/glm.hpp>
 #include "ecs/Mesh.hpp"
-#include "ecs/Texture.hpp"
+#include "ecs/MeshLibrary.hpp"
+#include "ecs/TextureCache.hpp"
 #include "ecs/Transform.hpp"
 #include "ecs/Collider.hpp"
 
-namespace
-{
-    // create a simple plane mesh centered at origin on the XZ plane (y = 0)
-    // repeatX / repeatZ control how many times the texture repeats across the plane
-    Mesh CreatePlaneMesh(float width, float depth, float repeatX = 1.0f, float repeatZ = 1.0f)
-    {
-        float hw = width * 0.5f;
-        float hd = depth * 0.5f;
-        float u0 = 0.0f;
-        float v0 = 0.0f;
-        float u1 = repeatX;
-        float v1 = repeatZ;
-        float vertices[] = {
-            -hw,
-            0.0f,
-            -hd,
-            0.0f,
-            1.0f,
-            0.0f,
-            u0,
-            v0,
-            hw,
-            0.0f,
-            -hd,
-            0.0f,
-            1.0f,
-            0.0f,
-            u1,
-            v0,
-            hw,
-            0.0f,
-            hd,
-            0.0f,
-            1.0f,
-            0.0f,
-            u1,
-            v1,
-            -hw,
-            0.0f,
-            hd,
-            0.0f,
-            1.0f,
-            0.0f,
-            u0,
-            v1,
-        };
-        unsigned int indices[] = {0, 1, 2, 2, 3, 0};
-
-        Mesh mesh;
-        glGenVertexArrays(1, &mesh.vao);
-        glGenBuffers(1, &mesh.vbo);
-        glGenBuffers(1, &mesh.ebo);
-
-        glBindVertexArray(mesh.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glBindVertexArray(0);
-
-        mesh.indexCount = static_cast<int>(sizeof(indices) / sizeof(unsigned int));
-        mesh.texture = 0;
-        mesh.color = glm::vec3(0.15f, 0.8f, 0.25f); // grassy green (fallback)
-        return mesh;
-    }
-
-    // create a unit cube mesh (centered at origin, size 1)
-    Mesh CreateUnitCube()
-    {
-        float vertices[] = {
-            // front (+Z)
-            -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-            0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
-            0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-            -0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-            // back (-Z)
-            -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f,
-            0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-            0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f,
-            -0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,
-            // left (-X)
-            -0.5f, -0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-            -0.5f, -0.5f, 0.5f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-            -0.5f, 0.5f, 0.5f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
-            -0.5f, 0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-            // right (+X)
-            0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-            0.5f, -0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-            0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-            0.5f, 0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
-            // top (+Y)
-            -0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-            0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-            0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,
-            -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-            // bottom (-Y)
-            -0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f,
-            0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 1.0f,
-            0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-            -0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f};
-
-        unsigned int indices[] = {
-            0, 1, 2, 2, 3, 0,
-            4, 5, 6, 6, 7, 4,
-            8, 9, 10, 10, 11, 8,
-            12, 13, 14, 14, 15, 12,
-            16, 17, 18, 18, 19, 16,
-            20, 21, 22, 22, 23, 20};
-
-        Mesh mesh;
-        glGenVertexArrays(1, &mesh.vao);
-        glGenBuffers(1, &mesh.vbo);
-        glGenBuffers(1, &mesh.ebo);
-
-        glBindVertexArray(mesh.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glBindVertexArray(0);
-
-        mesh.indexCount = static_cast<int>(sizeof(indices) / sizeof(unsigned int));
-        mesh.texture = 0;
-        mesh.color = glm::vec3(0.7f, 0.7f, 0.7f);
-        return mesh;
-    }
-}
-
 namespace World
 {
     void LoadFromFile(Registry &registry, const std::string &path, float tileSize)
@@ -184,11 +43,11 @@ namespace World
         // ground plane (repeat the grass texture per tile so it tiles across the map)
         float repeatsX = static_cast<float>(cols);
         float repeatsZ = static_cast<float>(rows);
-        Mesh groundMesh = CreatePlaneMesh(width, depth, repeatsX, repeatsZ);
+        Mesh groundMesh = MeshLibrary::Plane(width, depth, repeatsX, repeatsZ);
         Entity ground = registry.CreateEntity();
         registry.AddComponent<Transform>(ground, {{0.0f, 0.0f, 0.0f}, {0, 0, 0}, {1, 1, 1}});
         // try to load grass texture; if it fails we'll fall back to the green color
-        groundMesh.texture = Texture::Load("data/grass.jpg");
+        groundMesh.texture = TextureCache::Acquire("data/grass.jpg");
         registry.AddComponent<Mesh>(ground, groundMesh);
         Collider groundCol;
         groundCol.type = Collider::AABB;
@@ -196,9 +55,9 @@ namespace World
         registry.AddComponent<Collider>(ground, groundCol);
 
         // create one cube mesh and reuse it for all cubes
-        Mesh cubeMesh = CreateUnitCube();
+        Mesh cubeMesh = MeshLibrary::Cube();
         // try to texture cubes with wood
-        cubeMesh.texture = Texture::Load("data/wood.jpg");
+        cubeMesh.texture = TextureCache::Acquire("data/wood.jpg");
         cubeMesh.color = glm::vec3(0.6f, 0.4f, 0.2f); // earthy brown fallback
 
         // center offset so map is centered around origin
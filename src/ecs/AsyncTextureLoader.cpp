@@ -0,0 +1,261 @@
+#include "ecs/AsyncTextureLoader.hpp"
+#include "renderer/PboUploader.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <iostream>
+
+namespace
+{
+    struct Job
+    {
+        // either an image to decode...
+        std::string path;
+        bool flip = true;
+        std::function<void(DecodedImage &)> onReady;
+        DecodedImage image;
+        bool ok = false;
+        // ...or arbitrary work
+        std::function<void()> work;
+        std::function<void()> onDone;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::deque<Job> queued;   // waiting for a worker
+    std::deque<Job> decoded;  // waiting for Pump
+    size_t inFlight = 0;      // queued + decoding + decoded
+    bool stopping = false;
+
+    // textures handed out by Request whose upload is still outstanding (main thread only)
+    std::unordered_set<GLuint> pendingTextures;
+
+    void DecodeAndUpload(GLuint tex, const std::string &path, const TextureSettings &settings,
+                         const std::function<void(GLuint)> &onFailed)
+    {
+        // the budget is read here on the main thread; downscaling happens on the worker
+        TextureBudget limits = Texture::GetBudget();
+        size_t available = Texture::AvailableBytes();
+        auto image = std::make_shared<DecodedImage>();
+        auto ok = std::make_shared<bool>(false);
+        AsyncTextureLoader::RunOnWorker([image, ok, path, limits, available]()
+                                        {
+            *ok = Texture::Decode(path, true, *image);
+            if (*ok)
+                Texture::FitToBudget(*image, limits, available); },
+                                        [tex, path, settings, image, ok, onFailed]()
+                                        {
+            // the texture may have been deleted (and its name reused) while decoding
+            if (!pendingTextures.erase(tex))
+                return;
+            if (!*ok)
+            {
+                // like a failed synchronous load, but the name is already handed out
+                std::cerr << "Failed to load image: " << path << std::endl;
+                Texture::UploadMissing(tex, settings);
+                if (onFailed)
+                    onFailed(tex);
+                return;
+            }
+            if (PboUploader::IsActive())
+                PboUploader::Upload(tex, std::move(*image), settings);
+            else
+                Texture::Upload(tex, *image, settings); });
+    }
+
+    void WorkerLoop()
+    {
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, []
+                          { return stopping || !queued.empty(); });
+                if (stopping)
+                    return;
+                job = std::move(queued.front());
+                queued.pop_front();
+            }
+
+            if (job.work)
+                job.work();
+            else
+                job.ok = Texture::Decode(job.path, job.flip, job.image);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                decoded.push_back(std::move(job));
+            }
+            finished.notify_all();
+        }
+    }
+}
+
+void AsyncTextureLoader::Start(int count)
+{
+    if (!workers.empty())
+        return;
+    if (count <= 0)
+        count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    stopping = false;
+    for (int i = 0; i < count; ++i)
+        workers.emplace_back(WorkerLoop);
+    std::cerr << "AsyncTextureLoader: started " << count << " decode threads" << std::endl;
+}
+
+void AsyncTextureLoader::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &t : workers)
+        t.join();
+    workers.clear();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    queued.clear();
+    decoded.clear();
+    inFlight = 0;
+    pendingTextures.clear();
+}
+
+bool AsyncTextureLoader::IsRunning()
+{
+    return !workers.empty();
+}
+
+void AsyncTextureLoader::Submit(const std::string &path, bool flip, std::function<void(DecodedImage &)> onReady)
+{
+    Job job;
+    job.path = path;
+    job.flip = flip;
+    job.onReady = std::move(onReady);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(std::move(job));
+        ++inFlight;
+    }
+    wake.notify_one();
+}
+
+void AsyncTextureLoader::RunOnWorker(std::function<void()> work, std::function<void()> onDone)
+{
+    if (!IsRunning())
+    {
+        work();
+        onDone();
+        return;
+    }
+
+    Job job;
+    job.work = std::move(work);
+    job.onDone = std::move(onDone);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(std::move(job));
+        ++inFlight;
+    }
+    wake.notify_one();
+}
+
+GLuint AsyncTextureLoader::Request(const std::string &path, const TextureSettings &settings,
+                                   std::function<void(GLuint)> onFailed)
+{
+    GLuint tex = Texture::CreatePlaceholder(path, settings);
+    pendingTextures.insert(tex);
+
+    // baked mip chains only need reading off disk; the upload is a straight copy
+    std::string baked = Texture::FindBaked(path);
+    if (!baked.empty())
+    {
+        auto ktx = std::make_shared<Ktx::Image>();
+        auto ok = std::make_shared<bool>(false);
+        RunOnWorker([ktx, ok, baked]()
+                    { *ok = Ktx::Read(baked, *ktx); },
+                    [tex, settings, ktx, ok, path, onFailed]()
+                    {
+            if (!pendingTextures.count(tex))
+                return;
+            if (*ok)
+            {
+                pendingTextures.erase(tex);
+                Texture::Upload(tex, *ktx, settings);
+                return;
+            }
+            // unreadable bake: fall back to the source image
+            DecodeAndUpload(tex, path, settings, onFailed); });
+        return tex;
+    }
+
+    DecodeAndUpload(tex, path, settings, onFailed);
+    return tex;
+}
+
+void AsyncTextureLoader::Cancel(GLuint tex)
+{
+    pendingTextures.erase(tex);
+    PboUploader::Cancel(tex);
+}
+
+void AsyncTextureLoader::Pump(double budgetMs, int maxJobs)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int ran = 0; ran < maxJobs; ++ran)
+    {
+        if (ran > 0)
+        {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() >= budgetMs)
+                break;
+        }
+
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (decoded.empty())
+                break;
+            job = std::move(decoded.front());
+            decoded.pop_front();
+        }
+
+        if (job.onDone)
+            job.onDone();
+        else if (job.ok && job.onReady)
+            job.onReady(job.image);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        --inFlight;
+    }
+}
+
+void AsyncTextureLoader::Flush()
+{
+    if (!IsRunning())
+        return;
+    while (Pending() > 0)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, []
+                          { return !decoded.empty() || inFlight == 0; });
+        }
+        Pump(1e9, 1 << 30);
+    }
+}
+
+size_t AsyncTextureLoader::Pending()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return inFlight;
+}
@@ -0,0 +1,177 @@
+#include "ecs/BlockCompress.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+namespace
+{
+    // 4x4 texels as RGBA, edges clamped for sizes that aren't a multiple of 4
+    void FetchBlock(const DecodedImage &image, int bx, int by, unsigned char block[16][4])
+    {
+        const int c = image.channels;
+        for (int y = 0; y < 4; ++y)
+        {
+            int sy = std::min(by * 4 + y, image.height - 1);
+            for (int x = 0; x < 4; ++x)
+            {
+                int sx = std::min(bx * 4 + x, image.width - 1);
+                const unsigned char *p = image.pixels.data() + (static_cast<size_t>(sy) * image.width + sx) * c;
+                unsigned char *t = block[y * 4 + x];
+                t[0] = p[0];
+                t[1] = c > 1 ? p[1] : p[0];
+                t[2] = c > 2 ? p[2] : p[0];
+                t[3] = c > 3 ? p[3] : 255;
+            }
+        }
+    }
+
+    uint16_t To565(int r, int g, int b)
+    {
+        return static_cast<uint16_t>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+    }
+
+    void From565(uint16_t c, int rgb[3])
+    {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    void Put16(unsigned char *&out, uint16_t v)
+    {
+        *out++ = v & 0xFF;
+        *out++ = v >> 8;
+    }
+
+    void EncodeColor(const unsigned char block[16][4], unsigned char *out)
+    {
+        int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int ch = 0; ch < 3; ++ch)
+            {
+                lo[ch] = std::min(lo[ch], static_cast<int>(block[i][ch]));
+                hi[ch] = std::max(hi[ch], static_cast<int>(block[i][ch]));
+            }
+        }
+
+        uint16_t c0 = To565(hi[0], hi[1], hi[2]);
+        uint16_t c1 = To565(lo[0], lo[1], lo[2]);
+        // c0 > c1 selects the four-color mode
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        int palette[4][3];
+        From565(c0, palette[0]);
+        From565(c1, palette[1]);
+        for (int ch = 0; ch < 3; ++ch)
+        {
+            palette[2][ch] = (2 * palette[0][ch] + palette[1][ch]) / 3;
+            palette[3][ch] = (palette[0][ch] + 2 * palette[1][ch]) / 3;
+        }
+
+        uint32_t indices = 0;
+        if (c0 != c1)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0, bestDist = 1 << 30;
+                for (int p = 0; p < 4; ++p)
+                {
+                    int dr = block[i][0] - palette[p][0];
+                    int dg = block[i][1] - palette[p][1];
+                    int db = block[i][2] - palette[p][2];
+                    int dist = dr * dr + dg * dg + db * db;
+                    if (dist < bestDist)
+                    {
+                        bestDist = dist;
+                        best = p;
+                    }
+                }
+                indices |= static_cast<uint32_t>(best) << (i * 2);
+            }
+        }
+
+        Put16(out, c0);
+        Put16(out, c1);
+        for (int b = 0; b < 4; ++b)
+            *out++ = (indices >> (b * 8)) & 0xFF;
+    }
+
+    void EncodeAlpha(const unsigned char block[16][4], unsigned char *out)
+    {
+        int a0 = 0, a1 = 255;
+        for (int i = 0; i < 16; ++i)
+        {
+            a0 = std::max(a0, static_cast<int>(block[i][3]));
+            a1 = std::min(a1, static_cast<int>(block[i][3]));
+        }
+
+        // a0 > a1 selects eight interpolated values: a0, a1, then six steps from a0 towards a1
+        int palette[8] = {a0, a1};
+        for (int i = 1; i <= 6; ++i)
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+
+        uint64_t indices = 0;
+        if (a0 != a1)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0, bestDist = 256;
+                for (int p = 0; p < 8; ++p)
+                {
+                    int dist = std::abs(block[i][3] - palette[p]);
+                    if (dist < bestDist)
+                    {
+                        bestDist = dist;
+                        best = p;
+                    }
+                }
+                indices |= static_cast<uint64_t>(best) << (i * 3);
+            }
+        }
+
+        *out++ = static_cast<unsigned char>(a0);
+        *out++ = static_cast<unsigned char>(a1);
+        for (int b = 0; b < 6; ++b)
+            *out++ = (indices >> (b * 8)) & 0xFF;
+    }
+
+    template <typename EncodeFn>
+    std::vector<unsigned char> EncodeBlocks(const DecodedImage &image, size_t blockBytes, EncodeFn encode)
+    {
+        int blocksX = (image.width + 3) / 4;
+        int blocksY = (image.height + 3) / 4;
+        std::vector<unsigned char> out(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+        unsigned char *dst = out.data();
+        unsigned char block[16][4];
+        for (int by = 0; by < blocksY; ++by)
+        {
+            for (int bx = 0; bx < blocksX; ++bx)
+            {
+                FetchBlock(image, bx, by, block);
+                encode(block, dst);
+                dst += blockBytes;
+            }
+        }
+        return out;
+    }
+}
+
+namespace BlockCompress
+{
+    std::vector<unsigned char> EncodeBC1(const DecodedImage &image)
+    {
+        return EncodeBlocks(image, 8, [](const unsigned char block[16][4], unsigned char *out)
+                            { EncodeColor(block, out); });
+    }
+
+    std::vector<unsigned char> EncodeBC3(const DecodedImage &image)
+    {
+        return EncodeBlocks(image, 16, [](const unsigned char block[16][4], unsigned char *out)
+                            {
+            EncodeAlpha(block, out);
+            EncodeColor(block, out + 8); });
+    }
+}
@@ -6,6 +6,7 @@
 #include "ecs/Player.hpp"
 #include "ecs/Camera.hpp"
 #include "ecs/Mesh.hpp"
+#include "ecs/Light.hpp"
 #include <glm/glm.hpp>
 #include <algorithm>
 #include <cmath>
@@ -60,6 +61,7 @@ void CollisionSystem::Update(Registry &registry, float dt)
                 registry.RemoveComponent<Bullet>(be);
                 registry.RemoveComponent<Collider>(be);
                 registry.RemoveComponent<Velocity>(be);
+                registry.RemoveComponent<Light>(be);
                 break;
             }
         }
@@ -0,0 +1,229 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#include "ecs/ImageUtils.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DUCK_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // 2x2 box filter with clamped edges, for images with a side of 1
+    void DownsampleClamped(const DecodedImage &src, DecodedImage &out)
+    {
+        const int c = src.channels;
+        for (int y = 0; y < out.height; ++y)
+        {
+            int y0 = std::min(y * 2, src.height - 1);
+            int y1 = std::min(y * 2 + 1, src.height - 1);
+            const unsigned char *r0 = src.pixels.data() + static_cast<size_t>(y0) * src.width * c;
+            const unsigned char *r1 = src.pixels.data() + static_cast<size_t>(y1) * src.width * c;
+            unsigned char *dst = out.pixels.data() + static_cast<size_t>(y) * out.width * c;
+            for (int x = 0; x < out.width; ++x)
+            {
+                int x0 = std::min(x * 2, src.width - 1) * c;
+                int x1 = std::min(x * 2 + 1, src.width - 1) * c;
+                for (int ch = 0; ch < c; ++ch)
+                    dst[x * c + ch] = static_cast<unsigned char>((r0[x0 + ch] + r0[x1 + ch] + r1[x0 + ch] + r1[x1 + ch] + 2) / 4);
+            }
+        }
+    }
+
+    // sums[i] = r0[i] + r1[i], widened to 16 bits
+    void SumRows(const unsigned char *r0, const unsigned char *r1, uint16_t *sums, size_t n)
+    {
+        size_t i = 0;
+#ifdef DUCK_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r0 + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r1 + i));
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i + 8), hi);
+        }
+#endif
+        for (; i < n; ++i)
+            sums[i] = static_cast<uint16_t>(r0[i] + r1[i]);
+    }
+
+    // averages horizontal pairs of RGBA row sums, two output texels per step.
+    // returns how many texels were written.
+    size_t AverageRgbaPairs(const uint16_t *sums, unsigned char *dst, int width)
+    {
+        size_t x = 0;
+#ifdef DUCK_SSE2
+        const __m128i two = _mm_set1_epi16(2);
+        for (; x + 2 <= static_cast<size_t>(width); x += 2)
+        {
+            // a = texels 0,1 and b = texels 2,3 of the four source columns
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + x * 8));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + x * 8 + 8));
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x * 4), _mm_packus_epi16(sum, sum));
+        }
+#else
+        (void)sums;
+        (void)dst;
+        (void)width;
+#endif
+        return x;
+    }
+}
+
+namespace ImageUtils
+{
+    bool Decode(const std::string &path, bool flip, DecodedImage &out)
+    {
+        // stb's flip flag is global state shared across threads, so rows are flipped here instead
+        int width, height, channels;
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+        if (!data)
+        {
+            std::cerr << "Failed to load image: " << path << std::endl;
+            return false;
+        }
+
+        out.path = path;
+        out.width = width;
+        out.height = height;
+        out.channels = channels;
+        size_t rowBytes = static_cast<size_t>(width) * channels;
+        out.pixels.resize(rowBytes * height);
+        for (int y = 0; y < height; ++y)
+        {
+            int src = flip ? height - 1 - y : y;
+            std::memcpy(out.pixels.data() + y * rowBytes, data + src * rowBytes, rowBytes);
+        }
+        stbi_image_free(data);
+        return true;
+    }
+
+    DecodedImage Extract(const DecodedImage &src, int x, int y, int w, int h)
+    {
+        DecodedImage out;
+        out.path = src.path;
+        out.width = w;
+        out.height = h;
+        out.channels = src.channels;
+        size_t rowBytes = static_cast<size_t>(w) * src.channels;
+        size_t srcRowBytes = static_cast<size_t>(src.width) * src.channels;
+        out.pixels.resize(rowBytes * h);
+        for (int row = 0; row < h; ++row)
+        {
+            const unsigned char *s = src.pixels.data() + (y + row) * srcRowBytes + static_cast<size_t>(x) * src.channels;
+            std::memcpy(out.pixels.data() + row * rowBytes, s, rowBytes);
+        }
+        return out;
+    }
+
+    DecodedImage ToRgba(const DecodedImage &src)
+    {
+        if (src.channels == 4)
+            return src;
+        DecodedImage out;
+        out.path = src.path;
+        out.width = src.width;
+        out.height = src.height;
+        out.channels = 4;
+        size_t count = static_cast<size_t>(src.width) * src.height;
+        out.pixels.resize(count * 4);
+        const int c = src.channels;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const unsigned char *p = src.pixels.data() + i * c;
+            unsigned char *d = out.pixels.data() + i * 4;
+            d[0] = p[0];
+            d[1] = c > 1 ? p[1] : p[0];
+            d[2] = c > 2 ? p[2] : p[0];
+            d[3] = 255;
+        }
+        return out;
+    }
+
+    DecodedImage Resize(const DecodedImage &src, int w, int h)
+    {
+        if (src.width == w && src.height == h)
+            return src;
+        DecodedImage out;
+        out.path = src.path;
+        out.width = w;
+        out.height = h;
+        out.channels = src.channels;
+        out.pixels.resize(static_cast<size_t>(w) * h * src.channels);
+
+        const int c = src.channels;
+        float sx = static_cast<float>(src.width) / w;
+        float sy = static_cast<float>(src.height) / h;
+        for (int y = 0; y < h; ++y)
+        {
+            float fy = std::max(0.0f, (y + 0.5f) * sy - 0.5f);
+            int y0 = std::min(static_cast<int>(fy), src.height - 1);
+            int y1 = std::min(y0 + 1, src.height - 1);
+            float ty = fy - y0;
+            for (int x = 0; x < w; ++x)
+            {
+                float fx = std::max(0.0f, (x + 0.5f) * sx - 0.5f);
+                int x0 = std::min(static_cast<int>(fx), src.width - 1);
+                int x1 = std::min(x0 + 1, src.width - 1);
+                float tx = fx - x0;
+                for (int ch = 0; ch < c; ++ch)
+                {
+                    auto at = [&](int px, int py)
+                    { return static_cast<float>(src.pixels[(static_cast<size_t>(py) * src.width + px) * c + ch]); };
+                    float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * tx;
+                    float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * tx;
+                    out.pixels[(static_cast<size_t>(y) * w + x) * c + ch] = static_cast<unsigned char>(top + (bottom - top) * ty + 0.5f);
+                }
+            }
+        }
+        return out;
+    }
+
+    DecodedImage Downsample(const DecodedImage &src)
+    {
+        DecodedImage out;
+        out.path = src.path;
+        out.width = std::max(1, src.width / 2);
+        out.height = std::max(1, src.height / 2);
+        out.channels = src.channels;
+        out.pixels.resize(static_cast<size_t>(out.width) * out.height * out.channels);
+
+        // with both sides >= 2 every output texel has four in-bounds sources
+        if (src.width < 2 || src.height < 2)
+        {
+            DownsampleClamped(src, out);
+            return out;
+        }
+
+        const int c = src.channels;
+        const size_t pairBytes = static_cast<size_t>(out.width) * 2 * c;
+        std::vector<uint16_t> sums(pairBytes);
+        for (int y = 0; y < out.height; ++y)
+        {
+            const unsigned char *r0 = src.pixels.data() + static_cast<size_t>(y * 2) * src.width * c;
+            const unsigned char *r1 = r0 + static_cast<size_t>(src.width) * c;
+            unsigned char *dst = out.pixels.data() + static_cast<size_t>(y) * out.width * c;
+
+            SumRows(r0, r1, sums.data(), pairBytes);
+            size_t x = 0;
+            if (c == 4)
+                x = AverageRgbaPairs(sums.data(), dst, out.width);
+            for (; x < static_cast<size_t>(out.width); ++x)
+            {
+                const uint16_t *s = sums.data() + x * 2 * c;
+                for (int ch = 0; ch < c; ++ch)
+                    dst[x * c + ch] = static_cast<unsigned char>((s[ch] + s[c + ch] + 2) >> 2);
+            }
+        }
+        return out;
+    }
+}
@@ -0,0 +1,196 @@
+#include "ecs/Ktx.hpp"
+#include "ecs/BlockCompress.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    const unsigned char identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+    const uint32_t endianness = 0x04030201;
+
+    struct Header
+    {
+        unsigned char identifier[12];
+        uint32_t endianness;
+        uint32_t glType;
+        uint32_t glTypeSize;
+        uint32_t glFormat;
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+
+    // rows stored bottom-up, as decoded with flip for GL
+    const char orientationKey[] = "KTXorientation";
+    const char orientationValue[] = "S=r,T=u";
+
+    size_t Pad4(size_t n)
+    {
+        return (n + 3) & ~static_cast<size_t>(3);
+    }
+
+    // copies tightly packed rows into 4-byte aligned rows
+    std::vector<unsigned char> PadRows(const DecodedImage &image)
+    {
+        size_t rowBytes = static_cast<size_t>(image.width) * image.channels;
+        size_t stride = Pad4(rowBytes);
+        if (stride == rowBytes)
+            return image.pixels;
+        std::vector<unsigned char> out(stride * image.height, 0);
+        for (int y = 0; y < image.height; ++y)
+            std::memcpy(out.data() + y * stride, image.pixels.data() + y * rowBytes, rowBytes);
+        return out;
+    }
+
+    void Put32(std::ofstream &out, uint32_t v)
+    {
+        out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+}
+
+namespace Ktx
+{
+    Image Build(const DecodedImage &image, bool compress)
+    {
+        Image out;
+        out.width = image.width;
+        out.height = image.height;
+
+        bool compressed = compress && (image.channels == 3 || image.channels == 4);
+        if (compressed)
+        {
+            out.glType = 0;
+            out.glFormat = 0;
+            out.glInternalFormat = image.channels == 4 ? Bc3 : Bc1;
+            out.glBaseInternalFormat = image.channels == 4 ? Rgba : Rgb;
+        }
+        else
+        {
+            out.glType = UnsignedByte;
+            out.glFormat = image.channels == 1 ? Red : image.channels == 4 ? Rgba : Rgb;
+            out.glInternalFormat = image.channels == 1 ? R8 : image.channels == 4 ? Rgba8 : Rgb8;
+            out.glBaseInternalFormat = out.glFormat;
+        }
+
+        DecodedImage level = image;
+        for (;;)
+        {
+            if (!compressed)
+                out.levels.push_back(PadRows(level));
+            else if (image.channels == 4)
+                out.levels.push_back(BlockCompress::EncodeBC3(level));
+            else
+                out.levels.push_back(BlockCompress::EncodeBC1(level));
+
+            if (level.width == 1 && level.height == 1)
+                break;
+            level = ImageUtils::Downsample(level);
+        }
+        return out;
+    }
+
+    bool Read(const std::string &path, Image &out)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        Header h;
+        if (bytes.size() < sizeof(h))
+            return false;
+        std::memcpy(&h, bytes.data(), sizeof(h));
+        if (std::memcmp(h.identifier, identifier, sizeof(identifier)) != 0 || h.endianness != endianness)
+            return false;
+        // plain 2D textures only
+        if (h.pixelDepth > 1 || h.numberOfArrayElements != 0 || h.numberOfFaces != 1 || h.pixelWidth == 0 || h.pixelHeight == 0)
+            return false;
+
+        out = Image();
+        out.glType = h.glType;
+        out.glFormat = h.glFormat;
+        out.glInternalFormat = h.glInternalFormat;
+        out.glBaseInternalFormat = h.glBaseInternalFormat;
+        out.width = static_cast<int>(h.pixelWidth);
+        out.height = static_cast<int>(h.pixelHeight);
+
+        size_t offset = sizeof(h) + h.bytesOfKeyValueData;
+        uint32_t levels = std::max(1u, h.numberOfMipmapLevels);
+        for (uint32_t level = 0; level < levels; ++level)
+        {
+            uint32_t imageSize = 0;
+            if (offset + sizeof(imageSize) > bytes.size())
+                return false;
+            std::memcpy(&imageSize, bytes.data() + offset, sizeof(imageSize));
+            offset += sizeof(imageSize);
+            if (offset + imageSize > bytes.size())
+                return false;
+            out.levels.emplace_back(bytes.begin() + offset, bytes.begin() + offset + imageSize);
+            offset += Pad4(imageSize);
+        }
+        return true;
+    }
+
+    bool Write(const std::string &path, const Image &image)
+    {
+        // write beside the target and rename, so a crash never leaves a truncated file behind
+        std::string tmpPath = path + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary);
+            if (!out)
+                return false;
+
+            uint32_t kvSize = static_cast<uint32_t>(sizeof(orientationKey) + sizeof(orientationValue));
+            uint32_t kvBytes = static_cast<uint32_t>(sizeof(uint32_t) + Pad4(kvSize));
+
+            Header h{};
+            std::memcpy(h.identifier, identifier, sizeof(identifier));
+            h.endianness = endianness;
+            h.glType = image.glType;
+            h.glTypeSize = 1;
+            h.glFormat = image.glFormat;
+            h.glInternalFormat = image.glInternalFormat;
+            h.glBaseInternalFormat = image.glBaseInternalFormat;
+            h.pixelWidth = image.width;
+            h.pixelHeight = image.height;
+            h.numberOfFaces = 1;
+            h.numberOfMipmapLevels = static_cast<uint32_t>(image.levels.size());
+            h.bytesOfKeyValueData = kvBytes;
+            out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+
+            const char zeros[4] = {};
+            Put32(out, kvSize);
+            out.write(orientationKey, sizeof(orientationKey));
+            out.write(orientationValue, sizeof(orientationValue));
+            out.write(zeros, Pad4(kvSize) - kvSize);
+
+            for (const auto &level : image.levels)
+            {
+                Put32(out, static_cast<uint32_t>(level.size()));
+                out.write(reinterpret_cast<const char *>(level.data()), level.size());
+                out.write(zeros, Pad4(level.size()) - level.size());
+            }
+            if (!out)
+                return false;
+        }
+        std::remove(path.c_str());
+        return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+    std::string PathFor(const std::string &sourcePath, bool compressed)
+    {
+        size_t dot = sourcePath.find_last_of('.');
+        size_t slash = sourcePath.find_last_of("/\\");
+        std::string stem = (dot == std::string::npos || (slash != std::string::npos && dot < slash)) ? sourcePath : sourcePath.substr(0, dot);
+        return stem + (compressed ? ".bc.ktx" : ".ktx");
+    }
+}
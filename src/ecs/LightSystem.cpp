@@ -17,7 +17,8 @@ void LightSystem::Update(Registry &registry, float dt)
     for (auto [e, light] : registry.View<Light>())
     {
         auto transform = registry.GetComponent<Transform>(e);
-        if (!transform)
+        // point lights come and go with bullets; edit the main light only
+        if (!transform || light->radius > 0.0f)
             continue;
         ImGui::Begin("Light");
         ImGui::ColorEdit3("Color", &light->color.x);
@@ -0,0 +1,458 @@
+#include "ecs/Lightmap.hpp"
+#include "ecs/AsyncTextureLoader.hpp"
+#include "renderer/GLState.hpp"
+#include "renderer/GpuResources.hpp"
+#include "util/BinaryCache.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+namespace
+{
+    const char magic[4] = {'L', 'M', 'A', 'P'};
+    // bump when the bake itself changes so old caches miss
+    const uint32_t bakeVersion = 2;
+
+    // RGB light, A the share of it that came straight from the sun
+    const int channels = 4;
+
+    // surface points are pushed this far off their surface before casting
+    const float rayOffset = 0.01f;
+
+    uint32_t HashTexel(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // low-discrepancy point i of n; the per-texel offset decorrelates neighbours
+    glm::vec2 Hammersley(uint32_t i, uint32_t n, const glm::vec2 &offset)
+    {
+        uint32_t bits = i;
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        float x = static_cast<float>(i) / static_cast<float>(n) + offset.x;
+        float y = static_cast<float>(bits) * 2.3283064365386963e-10f + offset.y;
+        return glm::vec2(x - std::floor(x), y - std::floor(y));
+    }
+
+    bool Solid(const LightmapScene &scene, int col, int row)
+    {
+        if (col < 0 || col >= scene.cols)
+            return false;
+        if (scene.wrapRows)
+            row = ((row % scene.rows) + scene.rows) % scene.rows;
+        else if (row < 0 || row >= scene.rows)
+            return false;
+        return scene.solid[static_cast<size_t>(row) * scene.cols + col] != 0;
+    }
+
+    // first hit of o + t * d against the ground and the wall columns, walking
+    // the grid cell by cell (Amanatides & Woo) while the ray is below the wall tops
+    bool Trace(const LightmapScene &scene, const glm::vec3 &o, const glm::vec3 &d, float maxT, float &hitT, glm::vec3 &hitNormal)
+    {
+        const float inf = std::numeric_limits<float>::infinity();
+        const glm::vec3 up(0.0f, 1.0f, 0.0f);
+
+        float tEnd = maxT;
+        bool ground = false;
+        if (d.y < 0.0f && -o.y / d.y < tEnd)
+        {
+            tEnd = -o.y / d.y;
+            ground = true;
+        }
+        // walls only exist between the ground and their tops
+        float t = 0.0f;
+        if (o.y > scene.wallHeight)
+        {
+            if (d.y >= 0.0f)
+                return false;
+            t = (o.y - scene.wallHeight) / -d.y;
+        }
+        if (d.y > 0.0f)
+            tEnd = std::min(tEnd, (scene.wallHeight - o.y) / d.y);
+
+        glm::vec3 p = o + d * t;
+        float ts = scene.tileSize;
+        int col = static_cast<int>(std::floor((p.x - scene.origin.x) / ts));
+        int row = static_cast<int>(std::floor((p.z - scene.origin.y) / ts));
+        int stepX = d.x > 0.0f ? 1 : -1;
+        int stepZ = d.z > 0.0f ? 1 : -1;
+        float tMaxX = d.x != 0.0f ? t + ((scene.origin.x + (col + (stepX > 0 ? 1 : 0)) * ts) - p.x) / d.x : inf;
+        float tMaxZ = d.z != 0.0f ? t + ((scene.origin.y + (row + (stepZ > 0 ? 1 : 0)) * ts) - p.z) / d.z : inf;
+        float tDeltaX = d.x != 0.0f ? ts / std::abs(d.x) : inf;
+        float tDeltaZ = d.z != 0.0f ? ts / std::abs(d.z) : inf;
+
+        // a ray starting in (or dropping into) a wall hits its top
+        glm::vec3 normal = up;
+        while (t < tEnd)
+        {
+            if (Solid(scene, col, row))
+            {
+                hitT = t;
+                hitNormal = normal;
+                return true;
+            }
+            if (tMaxX < tMaxZ)
+            {
+                t = tMaxX;
+                tMaxX += tDeltaX;
+                col += stepX;
+                normal = glm::vec3(static_cast<float>(-stepX), 0.0f, 0.0f);
+            }
+            else
+            {
+                t = tMaxZ;
+                tMaxZ += tDeltaZ;
+                row += stepZ;
+                normal = glm::vec3(0.0f, 0.0f, static_cast<float>(-stepZ));
+            }
+            // past the map's side edges nothing else can be hit
+            if ((col < 0 && stepX < 0) || (col >= scene.cols && stepX > 0))
+                break;
+            if (!scene.wrapRows && ((row < 0 && stepZ < 0) || (row >= scene.rows && stepZ > 0)))
+                break;
+        }
+        if (!ground)
+            return false;
+        hitT = -o.y / d.y;
+        hitNormal = up;
+        return true;
+    }
+
+    glm::vec3 SunLight(const LightmapScene &scene, const LightmapSettings &settings, const glm::vec3 &p, const glm::vec3 &n)
+    {
+        float ndotl = glm::dot(n, settings.sunDirection);
+        float t;
+        glm::vec3 hn;
+        if (ndotl <= 0.0f || Trace(scene, p, settings.sunDirection, settings.maxDistance, t, hn))
+            return glm::vec3(0.0f);
+        return settings.sunColor * ndotl;
+    }
+}
+
+int Lightmap::AddChart(const glm::vec3 &origin, const glm::vec3 &axisU, const glm::vec3 &axisV, const glm::vec3 &normal,
+                       float texelsPerUnit)
+{
+    Chart chart;
+    chart.origin = origin;
+    chart.axisU = axisU;
+    chart.axisV = axisV;
+    chart.normal = glm::normalize(normal);
+    chart.texelsU = std::max(1, static_cast<int>(std::ceil(glm::length(axisU) * texelsPerUnit - 1e-3f)));
+    chart.texelsV = std::max(1, static_cast<int>(std::ceil(glm::length(axisV) * texelsPerUnit - 1e-3f)));
+    charts.push_back(chart);
+    return static_cast<int>(charts.size()) - 1;
+}
+
+void Lightmap::Pack()
+{
+    // shelf packing, tallest first. every chart keeps a one texel gutter, so
+    // bilinear taps at its border never reach a neighbour
+    std::vector<size_t> order(charts.size());
+    size_t area = 0;
+    int widest = 0;
+    for (size_t i = 0; i < charts.size(); ++i)
+    {
+        order[i] = i;
+        area += static_cast<size_t>(charts[i].texelsU + 2) * (charts[i].texelsV + 2);
+        widest = std::max(widest, charts[i].texelsU + 2);
+    }
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b)
+                     { return charts[a].texelsV > charts[b].texelsV; });
+
+    width = std::max(widest, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(area)))));
+    width = (width + 3) & ~3;
+    int x = 0, y = 0, shelf = 0;
+    for (size_t i : order)
+    {
+        Chart &c = charts[i];
+        if (x + c.texelsU + 2 > width)
+        {
+            x = 0;
+            y += shelf;
+            shelf = 0;
+        }
+        c.x = x + 1;
+        c.y = y + 1;
+        x += c.texelsU + 2;
+        shelf = std::max(shelf, c.texelsV + 2);
+    }
+    height = std::max(4, (y + shelf + 3) & ~3);
+
+    owner.assign(static_cast<size_t>(width) * height, -1);
+    for (size_t i = 0; i < charts.size(); ++i)
+    {
+        const Chart &c = charts[i];
+        for (int v = 0; v < c.texelsV; ++v)
+            std::fill_n(owner.begin() + static_cast<size_t>(c.y + v) * width + c.x, c.texelsU, static_cast<int>(i));
+    }
+    texels.assign(owner.size() * channels, 0.0f);
+}
+
+glm::vec2 Lightmap::AtlasUV(int chart, const glm::vec3 &pos) const
+{
+    const Chart &c = charts[chart];
+    glm::vec3 rel = pos - c.origin;
+    float s = glm::dot(rel, c.axisU) / glm::dot(c.axisU, c.axisU);
+    float t = glm::dot(rel, c.axisV) / glm::dot(c.axisV, c.axisV);
+    return glm::vec2((c.x + s * c.texelsU) / width, (c.y + t * c.texelsV) / height);
+}
+
+uint64_t Lightmap::Key(const LightmapScene &scene, const LightmapSettings &settings) const
+{
+    using BinaryCache::Fnv1a;
+    using BinaryCache::HashValue;
+    uint64_t hash = HashValue(bakeVersion, BinaryCache::fnvOffset);
+    hash = HashValue(scene.rows, hash);
+    hash = HashValue(scene.cols, hash);
+    hash = HashValue(scene.tileSize, hash);
+    hash = HashValue(scene.wallHeight, hash);
+    hash = HashValue(scene.origin, hash);
+    hash = HashValue(scene.wrapRows, hash);
+    hash = Fnv1a(scene.solid.data(), scene.solid.size(), hash);
+
+    hash = HashValue(settings.sunDirection, hash);
+    hash = HashValue(settings.sunColor, hash);
+    hash = HashValue(settings.skyColor, hash);
+    hash = HashValue(settings.bounceAlbedo, hash);
+    hash = HashValue(settings.samples, hash);
+    hash = HashValue(settings.maxDistance, hash);
+
+    // the layout decides which texel is where
+    hash = HashValue(width, hash);
+    hash = HashValue(height, hash);
+    for (const Chart &c : charts)
+        hash = HashValue(c, hash);
+    return hash;
+}
+
+void Lightmap::BakeRows(const LightmapScene &scene, const LightmapSettings &settings, std::atomic<int> &nextRow)
+{
+    const uint32_t samples = static_cast<uint32_t>(std::max(1, settings.samples));
+    const float twoPi = 6.28318530718f;
+
+    for (int y = nextRow++; y < height; y = nextRow++)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            int index = owner[static_cast<size_t>(y) * width + x];
+            if (index < 0)
+                continue;
+            const Chart &c = charts[index];
+            float s = (x - c.x + 0.5f) / c.texelsU;
+            float t = (y - c.y + 0.5f) / c.texelsV;
+            glm::vec3 n = c.normal;
+            glm::vec3 p = c.origin + s * c.axisU + t * c.axisV + n * rayOffset;
+
+            glm::vec3 tangent = glm::normalize(glm::cross(std::abs(n.y) < 0.99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0), n));
+            glm::vec3 bitangent = glm::cross(n, tangent);
+
+            uint32_t seed = HashTexel(static_cast<uint32_t>(y * width + x));
+            glm::vec2 offset((seed & 0xFFFF) / 65536.0f, (seed >> 16) / 65536.0f);
+
+            // cosine-weighted hemisphere: the average of what the rays see is the irradiance
+            glm::vec3 gathered(0.0f);
+            for (uint32_t i = 0; i < samples; ++i)
+            {
+                glm::vec2 u = Hammersley(i, samples, offset);
+                float r = std::sqrt(u.x);
+                float phi = twoPi * u.y;
+                glm::vec3 dir = tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + n * std::sqrt(1.0f - u.x);
+
+                float hitT;
+                glm::vec3 hitNormal;
+                if (!Trace(scene, p, dir, settings.maxDistance, hitT, hitNormal))
+                {
+                    gathered += settings.skyColor;
+                    continue;
+                }
+                // one bounce: the sunlit surface the ray landed on reflects diffusely
+                glm::vec3 hp = p + dir * hitT + hitNormal * rayOffset;
+                gathered += settings.bounceAlbedo * SunLight(scene, settings, hp, hitNormal);
+            }
+
+            glm::vec3 sun = SunLight(scene, settings, p, n);
+            glm::vec3 light = sun + gathered / static_cast<float>(samples);
+            float *dst = texels.data() + (static_cast<size_t>(y) * width + x) * channels;
+            dst[0] = light.r;
+            dst[1] = light.g;
+            dst[2] = light.b;
+            // lets the shader take the sun back out where something dynamic shadows it
+            float total = light.r + light.g + light.b;
+            dst[3] = total > 0.0f ? (sun.r + sun.g + sun.b) / total : 0.0f;
+        }
+    }
+}
+
+void Lightmap::Dilate()
+{
+    std::vector<float> source = texels;
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            if (owner[static_cast<size_t>(y) * width + x] >= 0)
+                continue;
+            float sum[channels] = {};
+            int count = 0;
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    int nx = x + dx, ny = y + dy;
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                        continue;
+                    size_t n = static_cast<size_t>(ny) * width + nx;
+                    if (owner[n] < 0)
+                        continue;
+                    for (int ch = 0; ch < channels; ++ch)
+                        sum[ch] += source[n * channels + ch];
+                    ++count;
+                }
+            }
+            if (count == 0)
+                continue;
+            float *dst = texels.data() + (static_cast<size_t>(y) * width + x) * channels;
+            for (int ch = 0; ch < channels; ++ch)
+                dst[ch] = sum[ch] / count;
+        }
+    }
+}
+
+bool Lightmap::Bake(const LightmapScene &scene, const LightmapSettings &settings, const std::string &cacheDir, int workers)
+{
+    cached = false;
+    if (charts.empty() || width == 0 || scene.rows <= 0 || scene.cols <= 0 ||
+        scene.solid.size() != static_cast<size_t>(scene.rows) * scene.cols)
+    {
+        std::cerr << "Lightmap: nothing to bake" << std::endl;
+        return false;
+    }
+
+    uint64_t key = Key(scene, settings);
+    std::string path = BinaryCache::PathFor(cacheDir, key, ".lightmap");
+
+    // header, width, height; then RGBA floats
+    {
+        std::ifstream in(path, std::ios::binary);
+        int32_t w = 0, h = 0;
+        if (BinaryCache::ReadHeader(in, magic, bakeVersion, key) && BinaryCache::Read(in, w) && BinaryCache::Read(in, h) &&
+            w == width && h == height)
+        {
+            in.read(reinterpret_cast<char *>(texels.data()), static_cast<std::streamsize>(texels.size() * sizeof(float)));
+            if (in)
+            {
+                cached = true;
+                std::cerr << "Lightmap: loaded " << width << "x" << height << " from " << path << std::endl;
+                return true;
+            }
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (workers <= 0)
+        workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::atomic<int> nextRow{0};
+    std::vector<std::thread> threads;
+    for (int i = 1; i < workers; ++i)
+        threads.emplace_back([&]
+                             { BakeRows(scene, settings, nextRow); });
+    BakeRows(scene, settings, nextRow);
+    for (std::thread &t : threads)
+        t.join();
+    Dilate();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Lightmap: baked " << charts.size() << " charts into " << width << "x" << height << " on " << workers
+              << " threads in " << ms << " ms" << std::endl;
+
+    BinaryCache::WriteAtomic(path, [&](std::ostream &out)
+                             {
+        BinaryCache::WriteHeader(out, magic, bakeVersion, key);
+        BinaryCache::Write(out, static_cast<int32_t>(width));
+        BinaryCache::Write(out, static_cast<int32_t>(height));
+        out.write(reinterpret_cast<const char *>(texels.data()), static_cast<std::streamsize>(texels.size() * sizeof(float))); });
+    return true;
+}
+
+GLuint Lightmap::Upload()
+{
+    Free();
+    if (texels.empty())
+        return 0;
+    texture = GpuResources::CreateTexture("lightmap");
+    GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+    GLState::UnpackAlignment(4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, texels.data());
+    // no mipmaps: they would blend charts across their gutters
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GpuResources::SetBytes(GpuKind::Texture, texture, static_cast<size_t>(width) * height * 8);
+    return texture;
+}
+
+void Lightmap::Rebake(const LightmapScene &scene, const LightmapSettings &settings, const std::string &cacheDir)
+{
+    if (rebaking || !texture)
+        return;
+    // the worker bakes a private copy; charts and layout never change here
+    auto baker = std::make_shared<Lightmap>();
+    baker->charts = charts;
+    baker->owner = owner;
+    baker->texels.assign(texels.size(), 0.0f);
+    baker->width = width;
+    baker->height = height;
+    auto ok = std::make_shared<bool>(false);
+    if (!alive)
+        alive = std::make_shared<bool>(true);
+    rebaking = true;
+    AsyncTextureLoader::RunOnWorker([baker, ok, scene, settings, cacheDir]()
+                                    { *ok = baker->Bake(scene, settings, cacheDir); },
+                                    [this, baker, ok, token = alive]()
+                                    {
+        if (!*token)
+            return;
+        rebaking = false;
+        if (!*ok || !texture)
+            return;
+        texels = std::move(baker->texels);
+        cached = baker->cached;
+        // same texture name, so meshes holding Id() pick it up
+        GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+        GLState::UnpackAlignment(4);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, texels.data()); });
+}
+
+void Lightmap::Free()
+{
+    GpuResources::Destroy(GpuKind::Texture, texture);
+    texture = 0;
+}
+
+void Lightmap::Clear()
+{
+    if (alive)
+        *alive = false;
+    alive.reset();
+    rebaking = false;
+    Free();
+    charts.clear();
+    owner.clear();
+    texels.clear();
+    width = height = 0;
+    cached = false;
+}
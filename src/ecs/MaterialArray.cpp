@@ -0,0 +1,264 @@
+#include "ecs/MaterialArray.hpp"
+#include "ecs/AsyncTextureLoader.hpp"
+#include "ecs/BlockCompress.hpp"
+#include "ecs/Ktx.hpp"
+#include "renderer/GLState.hpp"
+#include "renderer/GpuResources.hpp"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+    // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT and its sRGB variant
+    const GLenum bc3Format = 0x83F3;
+    const GLenum bc3SrgbFormat = 0x8C4F;
+
+    // the byte budget never shrinks layers below this
+    const int minLayerSize = 32;
+
+    // an sRGB array is decoded to linear when sampled, so solid colors are
+    // encoded to come out the same as objectColor
+    unsigned char Encode(float linear, bool srgb)
+    {
+        float c = std::clamp(linear, 0.0f, 1.0f);
+        if (srgb)
+            c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        return static_cast<unsigned char>(c * 255.0f + 0.5f);
+    }
+
+    int LevelCount(int size)
+    {
+        int levels = 1;
+        for (; size > 1; size /= 2)
+            ++levels;
+        return levels;
+    }
+
+    size_t LevelBytes(int size, bool compressed)
+    {
+        if (compressed)
+            return static_cast<size_t>((size + 3) / 4) * ((size + 3) / 4) * 16;
+        return static_cast<size_t>(size) * size * 4;
+    }
+
+    // one layer with its whole mip chain
+    size_t ChainBytes(int size, bool compressed)
+    {
+        size_t bytes = 0;
+        for (int level = 0; level < LevelCount(size); ++level)
+            bytes += LevelBytes(std::max(1, size >> level), compressed);
+        return bytes;
+    }
+
+    // BC1 blocks become BC3 blocks behind an opaque alpha block. the encoder
+    // only writes four-color blocks, which BC3 decodes the same way.
+    std::vector<unsigned char> Bc1ToBc3(const std::vector<unsigned char> &bc1)
+    {
+        const unsigned char opaque[8] = {255, 255, 0, 0, 0, 0, 0, 0};
+        std::vector<unsigned char> out;
+        out.reserve(bc1.size() * 2);
+        for (size_t i = 0; i + 8 <= bc1.size(); i += 8)
+        {
+            out.insert(out.end(), opaque, opaque + 8);
+            out.insert(out.end(), bc1.begin() + i, bc1.begin() + i + 8);
+        }
+        return out;
+    }
+
+    // RGB rows padded to 4 bytes, as KTX stores them, to tight RGBA
+    std::vector<unsigned char> Rgb8ToRgba8(const std::vector<unsigned char> &rgb, int size)
+    {
+        size_t stride = (static_cast<size_t>(size) * 3 + 3) & ~static_cast<size_t>(3);
+        std::vector<unsigned char> out(static_cast<size_t>(size) * size * 4, 255);
+        for (int y = 0; y < size; ++y)
+        {
+            for (int x = 0; x < size; ++x)
+                std::copy_n(rgb.data() + y * stride + x * 3, 3, out.data() + (static_cast<size_t>(y) * size + x) * 4);
+        }
+        return out;
+    }
+
+    // the baked chain from its size x size level down, in the array's format.
+    // false when the bake has no such level or a format the array can't take.
+    bool FromBaked(const Ktx::Image &ktx, int size, bool compressed, std::vector<std::vector<unsigned char>> &out)
+    {
+        int first = 0;
+        int w = ktx.width, h = ktx.height;
+        for (; first < static_cast<int>(ktx.levels.size()) && (w > size || h > size); ++first)
+        {
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+        int levels = LevelCount(size);
+        if (w != size || h != size || first + levels > static_cast<int>(ktx.levels.size()))
+            return false;
+
+        out.clear();
+        for (int level = 0; level < levels; ++level)
+        {
+            const std::vector<unsigned char> &data = ktx.levels[first + level];
+            int levelSize = std::max(1, size >> level);
+            if (compressed && ktx.glInternalFormat == Ktx::Bc3)
+                out.push_back(data);
+            else if (compressed && ktx.glInternalFormat == Ktx::Bc1)
+                out.push_back(Bc1ToBc3(data));
+            else if (!compressed && ktx.glInternalFormat == Ktx::Rgba8)
+                out.push_back(data);
+            else if (!compressed && ktx.glInternalFormat == Ktx::Rgb8)
+                out.push_back(Rgb8ToRgba8(data, levelSize));
+            else
+                return false;
+            if (out.back().size() != LevelBytes(levelSize, compressed))
+                return false;
+        }
+        return true;
+    }
+}
+
+int MaterialArray::AddLayer(const std::string &path, const glm::vec3 &fallbackColor)
+{
+    layers.push_back({path, fallbackColor});
+    return static_cast<int>(layers.size()) - 1;
+}
+
+bool MaterialArray::Build(int layerSize, const TextureSettings &settings)
+{
+    Free();
+    if (layers.empty())
+        return false;
+
+    // power-of-two layers keep every mip level whole BC blocks or 1x1
+    size = 1;
+    while (size * 2 <= layerSize)
+        size *= 2;
+    const TextureBudget &budget = Texture::GetBudget();
+    while (budget.maxDimension > 0 && size > budget.maxDimension)
+        size /= 2;
+    // the baked BC variants are used whenever the driver can sample them
+    compressed = Texture::SupportsS3tc();
+    size_t available = Texture::AvailableBytes();
+    while (size > minLayerSize && ChainBytes(size, compressed) * layers.size() > available)
+        size /= 2;
+    format = compressed ? (settings.srgb ? bc3SrgbFormat : bc3Format) : (settings.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8);
+    int levels = LevelCount(size);
+
+    // every layer starts as its fallback color: one 4x4 block (or texel) repeated
+    std::vector<std::vector<unsigned char>> fills;
+    for (const Layer &layer : layers)
+    {
+        const glm::vec3 &c = layer.color;
+        DecodedImage solid;
+        solid.width = solid.height = 4;
+        solid.channels = 4;
+        for (int i = 0; i < 16; ++i)
+            solid.pixels.insert(solid.pixels.end(), {Encode(c.r, settings.srgb), Encode(c.g, settings.srgb), Encode(c.b, settings.srgb), 255});
+        fills.push_back(compressed ? BlockCompress::EncodeBC3(solid) : std::vector<unsigned char>(solid.pixels.begin(), solid.pixels.begin() + 4));
+    }
+
+    texture = GpuResources::CreateTexture("material array");
+    GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+    GLState::UnpackAlignment(4);
+    for (int level = 0; level < levels; ++level)
+    {
+        int levelSize = std::max(1, size >> level);
+        size_t layerBytes = LevelBytes(levelSize, compressed);
+        std::vector<unsigned char> pixels(layerBytes * layers.size());
+        for (size_t l = 0; l < layers.size(); ++l)
+        {
+            for (size_t i = 0; i < layerBytes; i += fills[l].size())
+                std::copy(fills[l].begin(), fills[l].end(), pixels.begin() + l * layerBytes + i);
+        }
+        if (compressed)
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, levelSize, levelSize, static_cast<GLsizei>(layers.size()), 0,
+                                   static_cast<GLsizei>(pixels.size()), pixels.data());
+        else
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, levelSize, levelSize, static_cast<GLsizei>(layers.size()), 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, settings.wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, settings.wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, settings.minFilter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, settings.magFilter);
+    GpuResources::SetBytes(GpuKind::Texture, texture, ChainBytes(size, compressed) * layers.size());
+
+    alive = std::make_shared<bool>(true);
+    for (size_t l = 0; l < layers.size(); ++l)
+        LoadLayer(static_cast<int>(l));
+
+    std::cerr << "MaterialArray: " << layers.size() << " layers of " << size << "x" << size << (compressed ? " BC3" : " RGBA8")
+              << " (" << ChainBytes(size, compressed) * layers.size() / 1024 << " KB)" << std::endl;
+    return true;
+}
+
+void MaterialArray::LoadLayer(int index)
+{
+    const std::string &path = layers[index].path;
+    if (path.empty())
+        return;
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec))
+    {
+        std::cerr << "MaterialArray: " << path << " not found, layer " << index << " stays a solid color" << std::endl;
+        return;
+    }
+
+    // like Texture::Load, a current bake is read instead of decoding the image.
+    // either way the worker hands back the full chain in the array's format.
+    std::string baked = Texture::FindBaked(path);
+    auto chain = std::make_shared<std::vector<std::vector<unsigned char>>>();
+    auto ok = std::make_shared<bool>(false);
+    int target = size;
+    bool bc = compressed;
+    AsyncTextureLoader::RunOnWorker([chain, ok, path, baked, target, bc]()
+                                    {
+        Ktx::Image ktx;
+        if (!baked.empty() && Ktx::Read(baked, ktx) && FromBaked(ktx, target, bc, *chain))
+        {
+            *ok = true;
+            return;
+        }
+        DecodedImage image;
+        if (!Texture::Decode(path, true, image))
+            return;
+        // halve with the box filter while possible, then resample the remainder
+        while (image.width >= target * 2 && image.height >= target * 2)
+            image = ImageUtils::Downsample(image);
+        image = ImageUtils::ToRgba(ImageUtils::Resize(image, target, target));
+        *chain = Ktx::Build(image, bc).levels;
+        *ok = true; },
+                                    [this, chain, ok, index, token = alive]()
+                                    {
+        if (!*token || !*ok)
+            return;
+        GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+        GLState::UnpackAlignment(4);
+        for (int level = 0; level < static_cast<int>(chain->size()) && level < LevelCount(size); ++level)
+        {
+            const std::vector<unsigned char> &data = (*chain)[level];
+            int levelSize = std::max(1, size >> level);
+            if (compressed)
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, index, levelSize, levelSize, 1, format,
+                                          static_cast<GLsizei>(data.size()), data.data());
+            else
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, index, levelSize, levelSize, 1, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+        } });
+}
+
+void MaterialArray::Free()
+{
+    if (alive)
+        *alive = false;
+    alive.reset();
+    GpuResources::Destroy(GpuKind::Texture, texture);
+    texture = 0;
+}
+
+void MaterialArray::Clear()
+{
+    Free();
+    layers.clear();
+}
@@ -0,0 +1,37 @@
+#include "ecs/MeshBatch.hpp"
+#include "ecs/Transform.hpp"
+
+void MeshBatch::Add(const MeshData &data, const glm::mat4 &transform, int layer, const ExtrasFn &extras)
+{
+    const int stride = MeshData::floatsPerVertex;
+    unsigned int base = static_cast<unsigned int>(vertices.size() / (stride + extraFloats));
+    glm::mat3 normalMat = Transform::NormalMatrix(transform);
+
+    vertices.reserve(vertices.size() + data.VertexCount() * (stride + extraFloats));
+    for (unsigned int v = 0; v < data.VertexCount(); ++v)
+    {
+        const float *src = data.vertices.data() + v * stride;
+        glm::vec3 p = glm::vec3(transform * glm::vec4(src[0], src[1], src[2], 1.0f));
+        glm::vec3 n = glm::normalize(normalMat * glm::vec3(src[3], src[4], src[5]));
+        Extras e = extras ? extras(p, n) : Extras();
+        vertices.insert(vertices.end(), {p.x, p.y, p.z, n.x, n.y, n.z, src[6], src[7], static_cast<float>(layer),
+                                         e.lightmapUV.x, e.lightmapUV.y, e.occlusion});
+    }
+
+    // a mirroring transform turns CCW triangles clockwise; reverse them back
+    glm::mat3 linear(transform);
+    bool mirrored = glm::dot(linear[0], glm::cross(linear[1], linear[2])) < 0.0f;
+
+    indices.reserve(indices.size() + data.indices.size());
+    for (size_t t = 0; t + 2 < data.indices.size(); t += 3)
+    {
+        indices.push_back(base + data.indices[t]);
+        indices.push_back(base + data.indices[t + (mirrored ? 2 : 1)]);
+        indices.push_back(base + data.indices[t + (mirrored ? 1 : 2)]);
+    }
+}
+
+Mesh MeshBatch::Upload(const std::string &label) const
+{
+    return MeshLibrary::Upload(vertices, indices, label, extraFloats);
+}
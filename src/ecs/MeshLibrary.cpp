@@ -0,0 +1,443 @@
+#include "ecs/MeshLibrary.hpp"
+#include "renderer/GLState.hpp"
+#include "renderer/GpuResources.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <iostream>
+
+namespace
+{
+    enum class Primitive
+    {
+        Cube,
+        Plane,
+        Wave,
+        Sphere
+    };
+
+    struct MeshKey
+    {
+        Primitive type;
+        float a = 0.0f, b = 0.0f, c = 0.0f, d = 0.0f;
+
+        bool operator<(const MeshKey &o) const
+        {
+            return std::tie(type, a, b, c, d) < std::tie(o.type, o.a, o.b, o.c, o.d);
+        }
+    };
+
+    struct MeshEntry
+    {
+        Mesh mesh;
+        int refs = 0;
+        size_t bytes = 0;
+    };
+
+    std::map<MeshKey, MeshEntry> entries;
+    std::unordered_map<GLuint, MeshKey> keyByVao;
+    size_t heldBytes = 0;
+
+    // plane centered at origin on the XZ plane (y = 0)
+    // repeatX / repeatZ control how many times the texture repeats across the plane
+    MeshData BuildPlane(float width, float depth, float repeatX, float repeatZ)
+    {
+        float hw = width * 0.5f;
+        float hd = depth * 0.5f;
+        MeshData g;
+        g.Push(-hw, 0.0f, -hd, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f);
+        g.Push(hw, 0.0f, -hd, 0.0f, 1.0f, 0.0f, repeatX, 0.0f);
+        g.Push(hw, 0.0f, hd, 0.0f, 1.0f, 0.0f, repeatX, repeatZ);
+        g.Push(-hw, 0.0f, hd, 0.0f, 1.0f, 0.0f, 0.0f, repeatZ);
+        g.indices = {0, 3, 2, 2, 1, 0};
+        return g;
+    }
+
+    // cube centered at origin with edge length `size`
+    MeshData BuildCube(float size)
+    {
+        float s = size * 0.5f;
+        MeshData g;
+        // front (+Z)
+        g.Push(-s, -s, s, 0, 0, 1, 0, 0);
+        g.Push(s, -s, s, 0, 0, 1, 1, 0);
+        g.Push(s, s, s, 0, 0, 1, 1, 1);
+        g.Push(-s, s, s, 0, 0, 1, 0, 1);
+        // back (-Z)
+        g.Push(-s, -s, -s, 0, 0, -1, 1, 0);
+        g.Push(s, -s, -s, 0, 0, -1, 0, 0);
+        g.Push(s, s, -s, 0, 0, -1, 0, 1);
+        g.Push(-s, s, -s, 0, 0, -1, 1, 1);
+        // left (-X)
+        g.Push(-s, -s, -s, -1, 0, 0, 0, 0);
+        g.Push(-s, -s, s, -1, 0, 0, 1, 0);
+        g.Push(-s, s, s, -1, 0, 0, 1, 1);
+        g.Push(-s, s, -s, -1, 0, 0, 0, 1);
+        // right (+X)
+        g.Push(s, -s, -s, 1, 0, 0, 1, 0);
+        g.Push(s, -s, s, 1, 0, 0, 0, 0);
+        g.Push(s, s, s, 1, 0, 0, 0, 1);
+        g.Push(s, s, -s, 1, 0, 0, 1, 1);
+        // top (+Y)
+        g.Push(-s, s, s, 0, 1, 0, 0, 0);
+        g.Push(s, s, s, 0, 1, 0, 1, 0);
+        g.Push(s, s, -s, 0, 1, 0, 1, 1);
+        g.Push(-s, s, -s, 0, 1, 0, 0, 1);
+        // bottom (-Y)
+        g.Push(-s, -s, s, 0, -1, 0, 0, 1);
+        g.Push(s, -s, s, 0, -1, 0, 1, 1);
+        g.Push(s, -s, -s, 0, -1, 0, 1, 0);
+        g.Push(-s, -s, -s, 0, -1, 0, 0, 0);
+
+        // the back, right and bottom faces list their corners clockwise seen
+        // from outside, so their triangles are emitted in reverse
+        for (unsigned int f = 0; f < 6; ++f)
+        {
+            unsigned int b = f * 4;
+            if (f % 2 == 0)
+                g.indices.insert(g.indices.end(), {b, b + 1, b + 2, b + 2, b + 3, b});
+            else
+                g.indices.insert(g.indices.end(), {b, b + 2, b + 1, b + 2, b, b + 3});
+        }
+        return g;
+    }
+
+    // sin-wave band spanning tileSize in X, filled down to y = 0
+    MeshData BuildWave(float tileSize, int segments)
+    {
+        int seg = std::max(4, segments);
+        float hw = tileSize * 0.5f;         // full tile width
+        float hd = tileSize * 0.15f;        // thickness in Z (half depth)
+        float amp = tileSize * 0.225f;      // amplitude
+        float extraLift = tileSize * 0.35f; // raise crest above the floor
+        float lift = amp + extraLift;
+        float baseY = 0.0f; // floor relative to mesh local origin
+        int waves = 1;      // number of wave cycles across the tile
+
+        MeshData g;
+        const float x0 = -hw;
+        const float x1 = hw;
+        auto sample = [&](int i, float &t, float &x, float &y)
+        {
+            t = static_cast<float>(i) / static_cast<float>(seg);
+            x = x0 + t * (x1 - x0);
+            y = lift + amp * sinf(2.0f * 3.14159265f * waves * t);
+        };
+
+        // top strip: back/top then front/top for each sample
+        for (int i = 0; i <= seg; ++i)
+        {
+            float t, x, y;
+            sample(i, t, x, y);
+            g.Push(x, y, -hd, 0.0f, 1.0f, 0.0f, t, 0.0f);
+            g.Push(x, y, hd, 0.0f, 1.0f, 0.0f, t, 1.0f);
+        }
+
+        // front vertical strip (connect top to baseY at +hd)
+        unsigned int frontStart = g.VertexCount();
+        for (int i = 0; i <= seg; ++i)
+        {
+            float t, x, y;
+            sample(i, t, x, y);
+            g.Push(x, y, hd, 0.0f, 0.0f, 1.0f, t, 0.0f);
+            g.Push(x, baseY, hd, 0.0f, 0.0f, 1.0f, t, 1.0f);
+        }
+
+        // back vertical strip (connect top to baseY at -hd)
+        unsigned int backStart = g.VertexCount();
+        for (int i = 0; i <= seg; ++i)
+        {
+            float t, x, y;
+            sample(i, t, x, y);
+            g.Push(x, y, -hd, 0.0f, 0.0f, -1.0f, t, 0.0f);
+            g.Push(x, baseY, -hd, 0.0f, 0.0f, -1.0f, t, 1.0f);
+        }
+
+        // bottom rectangle
+        unsigned int bottomStart = g.VertexCount();
+        g.Push(x0, baseY, hd, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f);
+        g.Push(x1, baseY, hd, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f);
+        g.Push(x1, baseY, -hd, 0.0f, -1.0f, 0.0f, 1.0f, 1.0f);
+        g.Push(x0, baseY, -hd, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f);
+
+        for (unsigned int i = 0; i < static_cast<unsigned int>(seg); ++i)
+        {
+            unsigned int a = i * 2;
+            g.indices.insert(g.indices.end(), {a, a + 1, a + 2, a + 2, a + 1, a + 3});
+        }
+        for (unsigned int i = 0; i < static_cast<unsigned int>(seg); ++i)
+        {
+            unsigned int a = frontStart + i * 2;
+            g.indices.insert(g.indices.end(), {a, a + 1, a + 2, a + 2, a + 1, a + 3});
+        }
+        for (unsigned int i = 0; i < static_cast<unsigned int>(seg); ++i)
+        {
+            unsigned int a = backStart + i * 2;
+            g.indices.insert(g.indices.end(), {a, a + 2, a + 1, a + 2, a + 3, a + 1});
+        }
+        g.indices.insert(g.indices.end(), {bottomStart, bottomStart + 2, bottomStart + 1,
+                                     bottomStart + 2, bottomStart, bottomStart + 3});
+
+        // left cap (x0)
+        unsigned int ltb = 0, ltf = 1;
+        unsigned int lfb = frontStart + 1, lbb = backStart + 1;
+        g.indices.insert(g.indices.end(), {ltb, lbb, ltf, ltf, lbb, lfb});
+
+        // right cap (x1)
+        unsigned int rtb = seg * 2, rtf = rtb + 1;
+        unsigned int rfb = frontStart + seg * 2 + 1, rbb = backStart + seg * 2 + 1;
+        g.indices.insert(g.indices.end(), {rtb, rtf, rbb, rbb, rtf, rfb});
+        return g;
+    }
+
+    // unit-radius UV sphere
+    MeshData BuildSphere(int lat, int lon)
+    {
+        MeshData g;
+        for (int y = 0; y <= lat; ++y)
+        {
+            float v = (float)y / (float)lat;
+            float theta = v * glm::pi<float>();
+            float sinTheta = sin(theta);
+            float cosTheta = cos(theta);
+
+            for (int x = 0; x <= lon; ++x)
+            {
+                float u = (float)x / (float)lon;
+                float phi = u * glm::two_pi<float>();
+                float px = sinTheta * cos(phi);
+                float py = cosTheta;
+                float pz = sinTheta * sin(phi);
+                g.Push(px, py, pz, px, py, pz, u, v);
+            }
+        }
+
+        for (int y = 0; y < lat; ++y)
+        {
+            for (int x = 0; x < lon; ++x)
+            {
+                unsigned int a = (y * (lon + 1)) + x;
+                unsigned int b = a + lon + 1;
+                g.indices.insert(g.indices.end(), {a, a + 1, b, b, a + 1, b + 1});
+            }
+        }
+        return g;
+    }
+
+    const char *primitiveNames[] = {"cube", "plane", "wave", "sphere"};
+
+    // the builders are meant to emit CCW triangles already; this catches edits that break it
+    MeshData Checked(MeshData g, Primitive type)
+    {
+        size_t flipped = MeshLibrary::NormalizeWinding(g.vertices, g.indices);
+        if (flipped)
+            std::cerr << "MeshLibrary: " << primitiveNames[static_cast<int>(type)] << " builder emitted " << flipped
+                      << " clockwise triangles, reversed them" << std::endl;
+        return g;
+    }
+
+    void FreeEntry(std::map<MeshKey, MeshEntry>::iterator it)
+    {
+        keyByVao.erase(it->second.mesh.vao);
+        heldBytes -= it->second.bytes;
+        MeshLibrary::Free(it->second.mesh);
+        entries.erase(it);
+    }
+
+    template <typename Build>
+    Mesh Acquire(const MeshKey &key, const glm::vec3 &color, Build build)
+    {
+        auto it = entries.find(key);
+        if (it == entries.end())
+        {
+            MeshData g = Checked(build(), key.type);
+            MeshEntry entry;
+            entry.mesh = MeshLibrary::Upload(g.vertices, g.indices, primitiveNames[static_cast<int>(key.type)]);
+            entry.mesh.color = color;
+            entry.bytes = g.vertices.size() * sizeof(float) + g.indices.size() * sizeof(unsigned int);
+            heldBytes += entry.bytes;
+            keyByVao[entry.mesh.vao] = key;
+            it = entries.emplace(key, entry).first;
+
+            // procedural meshes can always be rebuilt, so unreferenced ones may be evicted
+            GpuResources::SetReloadable(GpuKind::VertexArray, entry.mesh.vao, [key]()
+                                        {
+                auto e = entries.find(key);
+                if (e == entries.end() || e->second.refs > 0)
+                    return false;
+                FreeEntry(e);
+                return true; });
+        }
+        ++it->second.refs;
+        GpuResources::Touch(GpuKind::VertexArray, it->second.mesh.vao);
+        return it->second.mesh;
+    }
+}
+
+Mesh MeshLibrary::Upload(const std::vector<float> &vertices, const std::vector<unsigned int> &indices,
+                         const std::string &label, int extraFloats)
+{
+    Mesh mesh;
+    mesh.vao = GpuResources::CreateVertexArray(label);
+    mesh.vbo = GpuResources::CreateBuffer(label + " vertices");
+    mesh.ebo = GpuResources::CreateBuffer(label + " indices");
+
+    GLState::BindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    GpuResources::SetBytes(GpuKind::Buffer, mesh.vbo, vertices.size() * sizeof(float));
+    GpuResources::SetBytes(GpuKind::Buffer, mesh.ebo, indices.size() * sizeof(unsigned int));
+
+    GLsizei stride = static_cast<GLsizei>((MeshData::floatsPerVertex + extraFloats) * sizeof(float));
+    // position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+    glEnableVertexAttribArray(0);
+    // normal
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    // texcoord
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    // extra scalars
+    for (int i = 0; i < extraFloats; ++i)
+    {
+        GLuint loc = static_cast<GLuint>(3 + i);
+        glVertexAttribPointer(loc, 1, GL_FLOAT, GL_FALSE, stride, (void *)((MeshData::floatsPerVertex + i) * sizeof(float)));
+        glEnableVertexAttribArray(loc);
+    }
+    // unbind so later element buffer binds don't land in this VAO
+    GLState::BindVertexArray(0);
+
+    mesh.indexCount = static_cast<int>(indices.size());
+    mesh.texture = 0;
+
+    size_t floatsPerVertex = MeshData::floatsPerVertex + extraFloats;
+    for (size_t v = 0; v + floatsPerVertex <= vertices.size(); v += floatsPerVertex)
+    {
+        glm::vec3 p(vertices[v], vertices[v + 1], vertices[v + 2]);
+        mesh.boundsMin = mesh.hasBounds ? glm::min(mesh.boundsMin, p) : p;
+        mesh.boundsMax = mesh.hasBounds ? glm::max(mesh.boundsMax, p) : p;
+        mesh.hasBounds = true;
+    }
+    return mesh;
+}
+
+void MeshLibrary::Free(const Mesh &mesh)
+{
+    GpuResources::Destroy(GpuKind::Buffer, mesh.vbo);
+    GpuResources::Destroy(GpuKind::Buffer, mesh.ebo);
+    GpuResources::Destroy(GpuKind::VertexArray, mesh.vao);
+}
+
+size_t MeshLibrary::NormalizeWinding(const std::vector<float> &vertices, std::vector<unsigned int> &indices, int stride)
+{
+    size_t vertexCount = vertices.size() / stride;
+    auto position = [&](unsigned int i)
+    { return glm::vec3(vertices[i * stride], vertices[i * stride + 1], vertices[i * stride + 2]); };
+    auto normal = [&](unsigned int i)
+    { return glm::vec3(vertices[i * stride + 3], vertices[i * stride + 4], vertices[i * stride + 5]); };
+
+    size_t flipped = 0;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        unsigned int a = indices[t], b = indices[t + 1], c = indices[t + 2];
+        if (a >= vertexCount || b >= vertexCount || c >= vertexCount)
+            continue;
+        glm::vec3 e1 = position(b) - position(a);
+        glm::vec3 e2 = position(c) - position(a);
+        glm::vec3 face = glm::cross(e1, e2);
+        // relative threshold: slivers and collapsed pole triangles have no reliable facing
+        if (glm::dot(face, face) <= 1e-10f * glm::dot(e1, e1) * glm::dot(e2, e2))
+            continue;
+        if (glm::dot(face, normal(a) + normal(b) + normal(c)) < 0.0f)
+        {
+            std::swap(indices[t + 1], indices[t + 2]);
+            ++flipped;
+        }
+    }
+    return flipped;
+}
+
+MeshData MeshLibrary::CubeData(float size)
+{
+    return Checked(BuildCube(size), Primitive::Cube);
+}
+
+MeshData MeshLibrary::PlaneData(float width, float depth, float repeatX, float repeatZ)
+{
+    return Checked(BuildPlane(width, depth, repeatX, repeatZ), Primitive::Plane);
+}
+
+MeshData MeshLibrary::WaveData(float tileSize, int segments)
+{
+    return Checked(BuildWave(tileSize, segments), Primitive::Wave);
+}
+
+Mesh MeshLibrary::Cube(float size)
+{
+    return Acquire({Primitive::Cube, size}, glm::vec3(0.7f, 0.7f, 0.7f),
+                   [&]
+                   { return BuildCube(size); });
+}
+
+Mesh MeshLibrary::Plane(float width, float depth, float repeatX, float repeatZ)
+{
+    return Acquire({Primitive::Plane, width, depth, repeatX, repeatZ}, glm::vec3(0.15f, 0.8f, 0.25f),
+                   [&]
+                   { return BuildPlane(width, depth, repeatX, repeatZ); });
+}
+
+Mesh MeshLibrary::Wave(float tileSize, int segments)
+{
+    return Acquire({Primitive::Wave, tileSize, static_cast<float>(segments)}, glm::vec3(0.2f, 0.5f, 0.95f),
+                   [&]
+                   { return BuildWave(tileSize, segments); });
+}
+
+Mesh MeshLibrary::Sphere(int lat, int lon)
+{
+    return Acquire({Primitive::Sphere, static_cast<float>(lat), static_cast<float>(lon)}, glm::vec3(1.0f, 0.15f, 0.15f),
+                   [&]
+                   { return BuildSphere(lat, lon); });
+}
+
+void MeshLibrary::Release(const Mesh &mesh)
+{
+    auto k = keyByVao.find(mesh.vao);
+    if (k == keyByVao.end())
+    {
+        std::cerr << "MeshLibrary: release of unknown mesh vao=" << mesh.vao << std::endl;
+        return;
+    }
+    auto it = entries.find(k->second);
+    if (it->second.refs > 0)
+        --it->second.refs;
+    GpuResources::Touch(GpuKind::VertexArray, mesh.vao);
+}
+
+void MeshLibrary::Trim()
+{
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        auto next = std::next(it);
+        if (it->second.refs == 0)
+            FreeEntry(it);
+        it = next;
+    }
+}
+
+size_t MeshLibrary::GpuBytes()
+{
+    return heldBytes;
+}
+
+size_t MeshLibrary::MeshCount()
+{
+    return entries.size();
+}
@@ -1,5 +1,6 @@
 #include "ecs/Model.hpp"
-#include "ecs/Texture.hpp"
+#include "ecs/TextureCache.hpp"
+#include "ecs/MeshLibrary.hpp"
 #include <glm/glm.hpp>
 #include <cctype>
 #include <fstream>
@@ -179,13 +180,13 @@ Mesh Model::LoadFromOBJ(const std::string &path)
                     // normalize and try variants
                     texPath = fs::weakly_canonical(texPath);
                     if (fs::exists(texPath))
-                        tex = Texture::Load(texPath.string());
+                        tex = TextureCache::Acquire(texPath.string());
                     else
                     {
                         // try same directory with filename only
                         fs::path candidate = baseDir / fs::path(texRel).filename();
                         if (fs::exists(candidate))
-                            tex = Texture::Load(candidate.string());
+                            tex = TextureCache::Acquire(candidate.string());
                     }
                     if (tex)
                         break;
@@ -204,7 +205,7 @@ Mesh Model::LoadFromOBJ(const std::string &path)
                 c = (char)tolower(c);
             if (ext == ".jpg" || ext == ".jpeg" || ext == ".png")
             {
-                tex = Texture::Load(p.path().string());
+                tex = TextureCache::Acquire(p.path().string());
                 if (tex)
                     break;
             }
@@ -214,32 +215,20 @@ Mesh Model::LoadFromOBJ(const std::string &path)
     // create GL buffers if we have vertex data
     if (!vertexData.empty() && !indices.empty())
     {
-        glGenVertexArrays(1, &mesh.vao);
-        glGenBuffers(1, &mesh.vbo);
-        glGenBuffers(1, &mesh.ebo);
-
-        glBindVertexArray(mesh.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(float), vertexData.data(), GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-        // position
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-        // normal
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-        // texcoord
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-
-        glBindVertexArray(0);
-
-        mesh.indexCount = (int)indices.size();
+        // exporters disagree on winding; match the CCW convention culling expects
+        size_t flipped = MeshLibrary::NormalizeWinding(vertexData, indices);
+        if (flipped)
+            std::cerr << "Model::LoadFromOBJ - reversed " << flipped << " of " << indices.size() / 3
+                      << " triangles in " << path << std::endl;
+        mesh = MeshLibrary::Upload(vertexData, indices, path);
         mesh.texture = tex;
     }
 
     return mesh;
 }
+
+void Model::Free(const Mesh &mesh)
+{
+    MeshLibrary::Free(mesh);
+    TextureCache::Release(mesh.texture);
+}
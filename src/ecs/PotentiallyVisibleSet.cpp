@@ -0,0 +1,253 @@
+#include "ecs/PotentiallyVisibleSet.hpp"
+#include "util/BinaryCache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+namespace
+{
+    const char magic[4] = {'P', 'V', 'I', 'S'};
+    // bump when the bake itself changes so old caches miss
+    const uint32_t bakeVersion = 1;
+
+    // sample points stay this far inside their cell, off shared edges and corners
+    const float inset = 0.01f;
+
+    int WrapRow(const LightmapScene &scene, int row)
+    {
+        return scene.wrapRows ? ((row % scene.rows) + scene.rows) % scene.rows : row;
+    }
+
+    bool Solid(const LightmapScene &scene, int col, int row)
+    {
+        row = WrapRow(scene, row);
+        if (col < 0 || col >= scene.cols || row < 0 || row >= scene.rows)
+            return false;
+        return scene.solid[static_cast<size_t>(row) * scene.cols + col] != 0;
+    }
+}
+
+bool PotentiallyVisibleSet::Bake(const LightmapScene &map, const PvsSettings &settings, const std::string &cacheDir,
+                                 int workers)
+{
+    Clear();
+    if (map.rows <= 0 || map.cols <= 0 || map.solid.size() != static_cast<size_t>(map.rows) * map.cols)
+    {
+        std::cerr << "PotentiallyVisibleSet: nothing to bake" << std::endl;
+        return false;
+    }
+    scene = map;
+    rows = map.rows;
+    cols = map.cols;
+    words = (static_cast<size_t>(CellCount()) + 63) / 64;
+    bits.assign(static_cast<size_t>(CellCount()) * words, 0);
+
+    uint64_t key = Key(settings);
+    std::string path = BinaryCache::PathFor(cacheDir, key, ".pvs");
+
+    // header, rows, cols; then the bit rows
+    {
+        std::ifstream in(path, std::ios::binary);
+        int32_t r = 0, c = 0;
+        if (BinaryCache::ReadHeader(in, magic, bakeVersion, key) && BinaryCache::Read(in, r) && BinaryCache::Read(in, c) &&
+            r == rows && c == cols)
+        {
+            in.read(reinterpret_cast<char *>(bits.data()), static_cast<std::streamsize>(bits.size() * sizeof(uint64_t)));
+            if (in)
+            {
+                cached = true;
+                std::cerr << "PotentiallyVisibleSet: loaded " << rows << "x" << cols << " from " << path << std::endl;
+                return true;
+            }
+            std::fill(bits.begin(), bits.end(), 0);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (workers <= 0)
+        workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::atomic<int> nextCell{0};
+    std::vector<std::thread> threads;
+    for (int i = 1; i < workers; ++i)
+        threads.emplace_back([&]
+                             { BakeCells(settings, nextCell); });
+    BakeCells(settings, nextCell);
+    for (std::thread &t : threads)
+        t.join();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "PotentiallyVisibleSet: baked " << rows << "x" << cols << " cells (" << VisiblePairs()
+              << " visible pairs) on " << workers << " threads in " << ms << " ms" << std::endl;
+
+    BinaryCache::WriteAtomic(path, [&](std::ostream &out)
+                             {
+        BinaryCache::WriteHeader(out, magic, bakeVersion, key);
+        BinaryCache::Write(out, static_cast<int32_t>(rows));
+        BinaryCache::Write(out, static_cast<int32_t>(cols));
+        out.write(reinterpret_cast<const char *>(bits.data()), static_cast<std::streamsize>(bits.size() * sizeof(uint64_t))); });
+    return true;
+}
+
+void PotentiallyVisibleSet::Clear()
+{
+    scene = LightmapScene();
+    rows = cols = 0;
+    words = 0;
+    bits.clear();
+    cached = false;
+}
+
+uint64_t PotentiallyVisibleSet::Key(const PvsSettings &settings) const
+{
+    using BinaryCache::Fnv1a;
+    using BinaryCache::HashValue;
+    uint64_t hash = HashValue(bakeVersion, BinaryCache::fnvOffset);
+    hash = HashValue(scene.rows, hash);
+    hash = HashValue(scene.cols, hash);
+    hash = HashValue(scene.tileSize, hash);
+    hash = HashValue(scene.wrapRows, hash);
+    hash = Fnv1a(scene.solid.data(), scene.solid.size(), hash);
+    hash = HashValue(settings.maxDistance, hash);
+    hash = HashValue(settings.samplesPerAxis, hash);
+    return hash;
+}
+
+void PotentiallyVisibleSet::BakeCells(const PvsSettings &settings, std::atomic<int> &nextCell)
+{
+    const int n = std::max(1, settings.samplesPerAxis);
+    std::vector<float> offsets(n, 0.5f);
+    for (int i = 0; n > 1 && i < n; ++i)
+        offsets[i] = inset + (1.0f - 2.0f * inset) * i / (n - 1);
+
+    // in cells; the farthest points of two cells are a diagonal further apart than their corners
+    const float reach = settings.maxDistance / scene.tileSize + 1.5f;
+    const int copies = scene.wrapRows ? static_cast<int>(std::ceil(reach / rows)) : 0;
+
+    for (int from = nextCell++; from < CellCount(); from = nextCell++)
+    {
+        int fromRow = from / cols, fromCol = from % cols;
+        if (scene.solid[from])
+            continue;
+        uint64_t *row = bits.data() + static_cast<size_t>(from) * words;
+        for (int copy = -copies; copy <= copies; ++copy)
+        {
+            for (int to = 0; to < CellCount(); ++to)
+            {
+                if (row[to / 64] & (1ull << (to % 64)))
+                    continue;
+                // target cell in unwrapped grid coordinates
+                int toRow = to / cols + copy * rows, toCol = to % cols;
+                float dr = static_cast<float>(toRow - fromRow), dc = static_cast<float>(toCol - fromCol);
+                if (dr * dr + dc * dc > reach * reach)
+                    continue;
+
+                bool visible = false;
+                for (int i = 0; i < n * n && !visible; ++i)
+                {
+                    glm::vec2 a(fromCol + offsets[i % n], fromRow + offsets[i / n]);
+                    for (int j = 0; j < n * n && !visible; ++j)
+                        visible = RayClear(a, glm::vec2(toCol + offsets[j % n], toRow + offsets[j / n]));
+                }
+                if (visible)
+                    row[to / 64] |= 1ull << (to % 64);
+            }
+        }
+    }
+}
+
+bool PotentiallyVisibleSet::RayClear(const glm::vec2 &from, const glm::vec2 &to) const
+{
+    // grid DDA in cell units; the end cells themselves never block
+    int x = static_cast<int>(std::floor(from.x)), y = static_cast<int>(std::floor(from.y));
+    int endX = static_cast<int>(std::floor(to.x)), endY = static_cast<int>(std::floor(to.y));
+    float dx = to.x - from.x, dy = to.y - from.y;
+    int stepX = dx > 0.0f ? 1 : -1, stepY = dy > 0.0f ? 1 : -1;
+    const float inf = std::numeric_limits<float>::infinity();
+    float deltaX = dx != 0.0f ? std::abs(1.0f / dx) : inf;
+    float deltaY = dy != 0.0f ? std::abs(1.0f / dy) : inf;
+    float nextX = dx != 0.0f ? (stepX > 0 ? x + 1 - from.x : from.x - x) * deltaX : inf;
+    float nextY = dy != 0.0f ? (stepY > 0 ? y + 1 - from.y : from.y - y) * deltaY : inf;
+
+    for (int steps = std::abs(endX - x) + std::abs(endY - y); steps > 0; --steps)
+    {
+        if (nextX < nextY)
+        {
+            x += stepX;
+            nextX += deltaX;
+        }
+        else
+        {
+            y += stepY;
+            nextY += deltaY;
+        }
+        if ((x != endX || y != endY) && Solid(scene, x, y))
+            return false;
+    }
+    return true;
+}
+
+int PotentiallyVisibleSet::CellAt(const glm::vec3 &local) const
+{
+    if (bits.empty())
+        return -1;
+    int col = static_cast<int>(std::floor((local.x - scene.origin.x) / scene.tileSize));
+    int row = WrapRow(scene, static_cast<int>(std::floor((local.z - scene.origin.y) / scene.tileSize)));
+    if (col < 0 || col >= cols || row < 0 || row >= rows)
+        return -1;
+    return row * cols + col;
+}
+
+const uint64_t *PotentiallyVisibleSet::Row(int fromCell) const
+{
+    if (fromCell < 0 || fromCell >= CellCount() || scene.solid[fromCell])
+        return nullptr;
+    return bits.data() + static_cast<size_t>(fromCell) * words;
+}
+
+bool PotentiallyVisibleSet::IsVisible(int fromCell, int toCell) const
+{
+    const uint64_t *row = Row(fromCell);
+    if (!row || toCell < 0 || toCell >= CellCount())
+        return true;
+    return (row[toCell / 64] >> (toCell % 64)) & 1u;
+}
+
+bool PotentiallyVisibleSet::IsVisible(int fromCell, const glm::vec3 &localMin, const glm::vec3 &localMax) const
+{
+    const uint64_t *row = Row(fromCell);
+    if (!row)
+        return true;
+    int col0 = static_cast<int>(std::floor((localMin.x - scene.origin.x) / scene.tileSize));
+    int col1 = static_cast<int>(std::floor((localMax.x - scene.origin.x) / scene.tileSize));
+    int row0 = static_cast<int>(std::floor((localMin.z - scene.origin.y) / scene.tileSize));
+    int row1 = static_cast<int>(std::floor((localMax.z - scene.origin.y) / scene.tileSize));
+    if (col0 < 0 || col1 >= cols || (!scene.wrapRows && (row0 < 0 || row1 >= rows)))
+        return true;
+    // a box longer than the map covers every row
+    row1 = std::min(row1, row0 + rows - 1);
+    for (int r = row0; r <= row1; ++r)
+    {
+        int wrapped = WrapRow(scene, r);
+        for (int c = col0; c <= col1; ++c)
+        {
+            int cell = wrapped * cols + c;
+            if ((row[cell / 64] >> (cell % 64)) & 1u)
+                return true;
+        }
+    }
+    return false;
+}
+
+size_t PotentiallyVisibleSet::VisiblePairs() const
+{
+    size_t count = 0;
+    for (uint64_t word : bits)
+    {
+        for (; word; word &= word - 1)
+            ++count;
+    }
+    return count;
+}
@@ -2,42 +2,95 @@
 #include "ecs/SkyboxSystem.hpp"
 #include "ecs/Light.hpp"
 #include "ecs/FirstPerson.hpp"
+#include "ecs/MeshLibrary.hpp"
+#include "renderer/GLState.hpp"
 #include <glm/glm.hpp>
 #include <imgui.h>
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
 #include <string>
+#include <tuple>
 #include <iostream>
 
-// load file contents into a string
-static std::string ReadFileToString(const std::string &path)
+namespace
 {
-    std::ifstream in(path, std::ios::in | std::ios::binary);
-    if (!in)
-        return {};
-    std::ostringstream ss;
-    ss << in.rdbuf();
-    return ss.str();
-}
+    // runs shorter than this are drawn one by one; not worth an instance upload
+    const size_t minInstancedRun = 4;
+    // meshes this large get a hardware occlusion query, like world segments
+    const int minQueryIndices = 6144;
+    // a camera this close to a box may have it cut by the near plane; draw unconditionally
+    const float queryMargin = 0.5f;
 
-RenderSystem::RenderSystem()
-{
-    // load shaders from data/shaders/*
-    std::string vs = ReadFileToString("data/shaders/vertex.glsl");
-    std::string fs = ReadFileToString("data/shaders/fragment.glsl");
-    const char *vsrc = nullptr;
-    const char *fsrc = nullptr;
-    if (!vs.empty() && !fs.empty())
+    // first instance attribute location; 3.. are left for per-vertex extras
+    const GLuint instanceLocation = 8;
+
+    // opaque draws are sorted by distance bucket first, state second: near
+    // geometry fills the depth buffer early while runs within a bucket still batch.
+    // buckets double in size, so [0,1) [1,2) [2,4) ... [64,inf)
+    const int depthBuckets = 8;
+
+    // the gun sits a few decimetres in front of the eye; its own clip range
+    // keeps it out of the world's near plane and gives it depth precision
+    const float overlayNear = 0.01f;
+    const float overlayFar = 10.0f;
+
+    // world projection, shared by the froxel grid
+    const float fovY = glm::radians(45.0f);
+    const float zNear = 0.1f;
+    const float zFar = 100.0f;
+
+    // buffer textures of the light clusters, after the material units
+    const GLuint clusterUnit = 2;
+    const GLuint lightmapUnit = 5;
+
+    // static and dynamic shadow maps
+    const GLuint shadowUnit = 6;
+    // half the side of the per-frame shadow box around the camera
+    const float dynamicShadowRadius = 12.0f;
+
+    // MeshBatch's occlusion attribute; see vertex.glsl
+    const GLuint occlusionLocation = 6;
+
+    int DepthBucket(float depth)
     {
-        vsrc = vs.c_str();
-        fsrc = fs.c_str();
+        if (depth < 1.0f)
+            return 0;
+        return std::min(static_cast<int>(std::log2(depth)) + 1, depthBuckets - 1);
     }
-    else
+
+    // world-space box around a mesh's local bounds
+    void WorldBounds(const Mesh &mesh, const glm::mat4 &model, glm::vec3 &lo, glm::vec3 &hi)
     {
-        std::cerr << "Warning: failed to load shaders from data/shaders/" << std::endl;
+        lo = glm::vec3(std::numeric_limits<float>::infinity());
+        hi = glm::vec3(-std::numeric_limits<float>::infinity());
+        for (int i = 0; i < 8; ++i)
+        {
+            glm::vec3 corner((i & 1) ? mesh.boundsMax.x : mesh.boundsMin.x, (i & 2) ? mesh.boundsMax.y : mesh.boundsMin.y,
+                             (i & 4) ? mesh.boundsMax.z : mesh.boundsMin.z);
+            glm::vec3 p = glm::vec3(model * glm::vec4(corner, 1.0f));
+            lo = glm::vec3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+            hi = glm::vec3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+        }
     }
+}
+
+RenderSystem::RenderSystem()
+{
+    // load shaders from data/shaders/*; variants are compiled on first use
+    if (!shaders.Load("data/shaders/vertex.glsl", "data/shaders/fragment.glsl"))
+        std::cerr << "Warning: failed to load shaders from data/shaders/" << std::endl;
 
-    shader = new Shader(vsrc, fsrc);
+    // submit every variant the scene can need now; they compile while assets load
+    std::vector<uint32_t> variants;
+    for (uint32_t material : {0u, uint32_t(FeatureTextured), uint32_t(FeatureTextureArray), uint32_t(FeatureEmissive),
+                              uint32_t(FeatureTextureArray | FeatureLightmapped)})
+    {
+        variants.push_back(material);
+        variants.push_back(material | FeatureInstanced);
+    }
+    shaders.Prewarm(variants);
 
     view = glm::lookAt(glm::vec3(3, 2, 6),
                        glm::vec3(0, 0, 0),
@@ -46,16 +99,49 @@ RenderSystem::RenderSystem()
     proj = glm::perspective(glm::radians(45.0f),
                             800.0f / 600.0f, 0.1f, 100.0f);
 
-    glEnable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
+    GLState::Enable(GL_DEPTH_TEST);
+    // every mesh builder and the OBJ loader emit CCW front faces
+    GLState::Enable(GL_CULL_FACE);
+    GLState::CullFace(GL_BACK);
+    GLState::FrontFace(GL_CCW);
+    // a disabled attribute reads this constant, so meshes without baked
+    // occlusion come out fully open
+    glVertexAttrib1f(occlusionLocation, 1.0f);
     glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
-    glEnable(GL_FRAMEBUFFER_SRGB);
+    GLState::Enable(GL_FRAMEBUFFER_SRGB);
+}
+
+void RenderSystem::AddPasses(RenderGraph &g, RenderGraph::Resource color, RenderGraph::Resource depth)
+{
+    graph = &g;
+    // re-renders the static layer only when the light or the world changes
+    RenderGraph::Resource shadowMaps = g.Import("shadow maps");
+    g.AddPass({"shadows", {}, {shadowMaps}, [this]
+               { DrawShadows(); }});
+    // the prepass trades a second geometry submission for shading each
+    // visible pixel once; off by default since draws are already sorted front-to-back
+    g.AddPass({"depth prepass", {}, {depth}, [this]
+               { DrawDepthPrepass(); }});
+    g.SetEnabled("depth prepass", false);
+    g.AddPass({"opaque", {depth, shadowMaps}, {color, depth}, [this]
+               { DrawOpaque(); }});
+    // tests bounding boxes against the finished depth; next frame's draws
+    // wait on the results on the GPU
+    g.AddPass({"occlusion queries", {depth}, {}, [this]
+               { DrawOcclusionQueries(); }, true});
+    // after opaque, so depth testing rejects every pixel geometry already covered
+    g.AddPass({"skybox", {depth}, {color}, [this]
+               { DrawSkybox(); }});
+    // clears depth and draws view-space meshes over the finished world
+    g.AddPass({"first-person overlay", {shadowMaps}, {color, depth}, [this]
+               { DrawOverlay(); }});
 }
 
 void RenderSystem::Update(Registry &registry, float dt)
 {
-    if (!shader || shader->id == 0)
+    if (!shaders.Loaded())
         return;
+    shaders.Poll();
 
     // debugging: report counts once so we can see whether meshes exist
     static bool reported = false;
@@ -71,16 +157,9 @@ void RenderSystem::Update(Registry &registry, float dt)
         reported = true;
     }
 
+    // the clear honors the depth mask, so make sure it is on
+    GLState::DepthMask(true);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    shader->Use();
-
-    GLint vp[4] = {0, 0, 800, 600};
-    glGetIntegerv(GL_VIEWPORT, vp);
-    if (vp[3] > 0)
-    {
-        float aspect = static_cast<float>(vp[2]) / static_cast<float>(vp[3]);
-        proj = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
-    }
 
     // update camera view matrix from any Camera component, then upload
     for (auto [e, cam] : registry.View<Camera>())
@@ -89,151 +168,531 @@ void RenderSystem::Update(Registry &registry, float dt)
         break;
     }
 
-    shader->SetMat4("view", &view[0][0]);
-
-    // avoid stretching
+    // avoid stretching; the tracked viewport comes from Window, ImGui's size covers the first frame
+    const GLState::Viewport &vp = GLState::GetViewport();
     ImGuiIO &io = ImGui::GetIO();
-    float width = io.DisplaySize.x > 0.0f ? io.DisplaySize.x : 800.0f;
-    float height = io.DisplaySize.y > 0.0f ? io.DisplaySize.y : 600.0f;
-    proj = glm::perspective(glm::radians(45.0f), width / height, 0.1f, 100.0f);
-    shader->SetMat4("proj", &proj[0][0]);
-
-    // find first light in scene
-    glm::vec3 lightPos(0.0f);
-    glm::vec3 lightColor(1.0f);
-    float lightIntensity = 1.0f;
+    float width = vp.width > 0 ? static_cast<float>(vp.width) : (io.DisplaySize.x > 0.0f ? io.DisplaySize.x : 800.0f);
+    float height = vp.height > 0 ? static_cast<float>(vp.height) : (io.DisplaySize.y > 0.0f ? io.DisplaySize.y : 600.0f);
+    proj = glm::perspective(fovY, width / height, zNear, zFar);
+
+    // the first light without a radius is the main light; the rest are clustered
+    frame = FrameUniforms();
+    frame.view = view;
+    frame.proj = proj;
+    frame.tileWidth = width / LightClusters::tilesX;
+    frame.tileHeight = height / LightClusters::tilesY;
     for (auto [le, lptr] : registry.View<Light>())
     {
         auto ltransform = registry.GetComponent<Transform>(le);
-        if (ltransform && lptr)
+        if (ltransform && lptr && lptr->radius <= 0.0f)
         {
-            lightPos = ltransform->position;
-            lightColor = lptr->color;
-            lightIntensity = lptr->intensity;
+            frame.lightPos = ltransform->position;
+            frame.lightColor = lptr->color;
+            frame.lightIntensity = lptr->intensity;
             break;
         }
     }
 
+    // the main light casts shadows as a sun from its direction, as in the lightmap bake
+    float lightDistance = glm::length(frame.lightPos);
+    toLight = lightDistance > 0.0f ? frame.lightPos / lightDistance : glm::vec3(0.0f);
+
     // find camera position for specular/view calculations
-    glm::vec3 viewPos(0.0f);
     for (auto [ce, cam] : registry.View<Camera>())
     {
-        viewPos = cam->pos;
+        frame.viewPos = cam->pos;
         break;
     }
 
-    // set global light uniforms
-    GLint locLP = glGetUniformLocation(shader->id, "lightPos");
-    if (locLP >= 0)
-        glUniform3f(locLP, lightPos.x, lightPos.y, lightPos.z);
-    GLint locLC = glGetUniformLocation(shader->id, "lightColor");
-    if (locLC >= 0)
-        glUniform3f(locLC, lightColor.x, lightColor.y, lightColor.z);
-    GLint locLI = glGetUniformLocation(shader->id, "lightIntensity");
-    if (locLI >= 0)
-        glUniform1f(locLI, lightIntensity);
-    GLint locVP = glGetUniformLocation(shader->id, "viewPos");
-    if (locVP >= 0)
-        glUniform3f(locVP, viewPos.x, viewPos.y, viewPos.z);
+    // overlay meshes live in view space: identity view, the light moved into
+    // view space, and the eye at the origin
+    overlayFrame = frame;
+    overlayFrame.view = glm::mat4(1.0f);
+    overlayFrame.proj = glm::perspective(fovY, width / height, overlayNear, overlayFar);
+    overlayFrame.lightPos = glm::vec3(view * glm::vec4(frame.lightPos, 1.0f));
+    overlayFrame.viewPos = glm::vec3(0.0f);
+    // the view is rigid, so its inverse is the transposed rotation and the
+    // translation rotated back and negated
+    glm::mat3 toWorldRotation = glm::transpose(glm::mat3(view));
+    overlayFrame.toWorld = glm::mat4(toWorldRotation);
+    overlayFrame.toWorld[3] = glm::vec4(-(toWorldRotation * glm::vec3(view[3])), 1.0f);
 
-    // render skybox (if set) after clearing and camera/projection are updated
-    if (skybox)
+    CollectDraws(registry);
+    CollectLights(registry, width / height);
+}
+
+void RenderSystem::CollectLights(Registry &registry, float aspect)
+{
+    // the grid lives in view space, so lights move there once per frame
+    // instead of every fragment doing it
+    pointLights.clear();
+    for (auto [e, light] : registry.View<Light>())
     {
-        skybox->Update(registry, dt);
-        GLenum err = glGetError();
-        if (err != GL_NO_ERROR)
-            std::cerr << "RenderSystem: GL error after skybox draw: 0x" << std::hex << err << std::dec << std::endl;
+        if (light->radius <= 0.0f)
+            continue;
+        auto transform = registry.GetComponent<Transform>(e);
+        if (!transform)
+            continue;
+        PointLight p;
+        p.position = glm::vec3(view * glm::vec4(transform->position, 1.0f));
+        p.radius = light->radius;
+        p.color = light->color * light->intensity;
+        pointLights.push_back(p);
     }
+    clusters.Build(pointLights, fovY, aspect, zNear, zFar);
+    clusters.Upload();
+}
+
+void RenderSystem::DrawSkybox()
+{
+    if (!skybox)
+        return;
+    // the cube sits at max depth and is tested with GL_LEQUAL, so it only
+    // shades pixels nothing opaque was drawn to
+    skybox->Draw(view, proj);
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR)
+        std::cerr << "RenderSystem: GL error after skybox draw: 0x" << std::hex << err << std::dec << std::endl;
+}
+
+void RenderSystem::DrawShadows()
+{
+    if (toLight == glm::vec3(0.0f))
+    {
+        frame.staticShadows = frame.dynamicShadows = false;
+        overlayFrame.staticShadows = overlayFrame.dynamicShadows = false;
+        return;
+    }
+
+    // the casters draw with the plain variant, whose shadow samplers point at
+    // these units; leaving the maps bound there would read the texture being
+    // rendered. opaque and the overlay bind them again
+    GLState::BindTexture(shadowUnit, GL_TEXTURE_2D, 0);
+    GLState::BindTexture(shadowUnit + 1, GL_TEXTURE_2D, 0);
+
+    if (segmentMesh && segment.period > 0.0f)
+    {
+        shadows.UpdateStatic(toLight, segment.boundsMin, segment.boundsMax, segment.period, [this](const glm::mat4 &v, const glm::mat4 &p)
+                             {
+            // the copies on either side cast over the seams too
+            std::vector<DrawItem> copies(3);
+            for (int k = 0; k < 3; ++k)
+            {
+                copies[k].mesh = segmentMesh;
+                copies[k].instanceable = false;
+                copies[k].model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, (k - 1) * segment.period));
+            }
+            FrameUniforms lightFrame;
+            lightFrame.view = v;
+            lightFrame.proj = p;
+            SubmitDraws(copies, lightFrame, true); });
+    }
+
+    if (shadowCasters.empty())
+        shadows.ClearDynamic();
+    else
+        shadows.UpdateDynamic(toLight, frame.viewPos, dynamicShadowRadius, [this](const glm::mat4 &v, const glm::mat4 &p)
+                              {
+            FrameUniforms lightFrame;
+            lightFrame.view = v;
+            lightFrame.proj = p;
+            SubmitDraws(shadowCasters, lightFrame, true); });
+
+    for (FrameUniforms *f : {&frame, &overlayFrame})
+    {
+        f->staticShadows = shadows.StaticValid() && segmentMesh;
+        f->dynamicShadows = shadows.DynamicValid();
+        f->staticShadowMatrix = shadows.StaticMatrix();
+        f->dynamicShadowMatrix = shadows.DynamicMatrix();
+        f->segmentPhase = segmentPhase;
+        f->segmentPeriod = segment.period;
+    }
+}
+
+void RenderSystem::DrawDepthPrepass()
+{
+    GLState::DepthFunc(GL_LESS);
+    GLState::DepthMask(true);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    SubmitDraws(draws, frame, true);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void RenderSystem::DrawOcclusionQueries()
+{
+    if (queryTargets.empty())
+        return;
+    Shader *shader = shaders.Get(0);
+    if (!shader)
+        return;
+    if (!proxyBox.vao)
+        proxyBox = MeshLibrary::Cube();
 
-    // ensure our main shader is active again
     shader->Use();
+    ApplyFrameUniforms(*shader, frame);
+    // coplanar faces count as visible; the camera may look at a box from inside
+    GLState::DepthFunc(GL_LEQUAL);
+    GLState::DepthMask(false);
+    GLState::Disable(GL_CULL_FACE);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    GLState::BindVertexArray(proxyBox.vao);
+    glm::vec3 unit = proxyBox.boundsMax - proxyBox.boundsMin;
+    for (const QueryTarget &target : queryTargets)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), target.boundsMin);
+        model = glm::scale(model, (target.boundsMax - target.boundsMin) / unit);
+        model = glm::translate(model, -proxyBox.boundsMin);
+        shader->SetMat4("model", &model[0][0]);
+        queries.Begin(target.entity);
+        glDrawElements(GL_TRIANGLES, proxyBox.indexCount, GL_UNSIGNED_INT, 0);
+        queries.End();
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    GLState::Enable(GL_CULL_FACE);
+    GLState::DepthMask(true);
+    GLState::DepthFunc(GL_LESS);
+}
 
-    // make sure texture unit 0 is active and cube map unbound so mesh draws behave predictably
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+void RenderSystem::DrawOpaque()
+{
+    // with a prepass the depth buffer is final; only the nearest surface shades
+    bool prepass = graph && graph->IsEnabled("depth prepass");
+    GLState::DepthFunc(prepass ? GL_LEQUAL : GL_LESS);
+    GLState::DepthMask(!prepass);
+    clusters.Bind(clusterUnit);
+    shadows.Bind(shadowUnit, shadowUnit + 1);
+    SubmitDraws(draws, frame, false);
+    GLState::DepthMask(true);
+    GLState::DepthFunc(GL_LESS);
+
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR)
+        std::cerr << "RenderSystem: GL error after mesh draws: 0x" << std::hex << err << std::dec << std::endl;
+}
+
+void RenderSystem::DrawOverlay()
+{
+    if (overlayDraws.empty())
+        return;
+    GLState::DepthMask(true);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    // overlay view space is the world's, so the same froxels apply
+    clusters.Bind(clusterUnit);
+    shadows.Bind(shadowUnit, shadowUnit + 1);
+    SubmitDraws(overlayDraws, overlayFrame, false);
+}
+
+void RenderSystem::MakeDrawItem(Registry &registry, Entity e, const Mesh *mesh, const glm::mat4 &model, DrawItem &item) const
+{
+    item.mesh = mesh;
+    item.model = model;
+    item.normal = Transform::NormalMatrix(item.model);
+    if (mesh->textureArray)
+        item.features = FeatureTextureArray;
+    else if (mesh->texture)
+        item.features = FeatureTextured;
+    else
+    {
+        // untextured meshes with a Light component are drawn as emitters of their
+        // own light: a bullet glows in its color, the sun in the main light's
+        auto light = registry.GetComponent<Light>(e);
+        item.features = light ? FeatureEmissive : 0;
+        item.color = light ? light->color * light->intensity : mesh->color;
+    }
+    if (mesh->lightmap && !(item.features & FeatureEmissive))
+        item.features |= FeatureLightmapped;
+}
+
+void RenderSystem::CollectDraws(Registry &registry)
+{
+    // first-person meshes keep their camera-local transform and go to the overlay pass
+    overlayDraws.clear();
+    overlayEntities.clear();
+    for (auto [e, fp] : registry.View<FirstPerson>())
+    {
+        auto transform = registry.GetComponent<Transform>(e);
+        auto mesh = registry.GetComponent<Mesh>(e);
+        overlayEntities.push_back(e);
+        if (!transform || !mesh)
+            continue;
+        DrawItem item;
+        item.instanceable = false;
+        MakeDrawItem(registry, e, mesh, transform->GetMatrix(), item);
+        overlayDraws.push_back(item);
+    }
+
+    // collect draws with their shader features, then sort so each variant,
+    // texture and VAO is bound once per run
+    draws.clear();
+    shadowCasters.clear();
+    segmentMesh = nullptr;
+
+    queries.BeginFrame();
+    queryTargets.clear();
+
+    // walls first, so every draw below can be tested against them
+    occlusion.Begin(proj * view);
+    pvs = nullptr;
+    for (auto [e, seg] : registry.View<WorldSegment>())
+    {
+        auto transform = registry.GetComponent<Transform>(e);
+        if (!transform)
+            continue;
+        for (const WorldSegment::Box &box : seg->occluders)
+            occlusion.AddOccluder(box.min + transform->position, box.max + transform->position);
+        if (!pvs && seg->pvs && !seg->pvs->Empty())
+        {
+            pvs = seg->pvs;
+            pvsOrigin = transform->position;
+            wallTop = seg->boundsMax.y;
+        }
+    }
+    // cells only hide each other below the wall tops
+    cameraCell = pvs && frame.viewPos.y < wallTop ? pvs->CellAt(frame.viewPos - pvsOrigin) : -1;
+    pvsCulled = 0;
 
     for (auto [e, transform] : registry.View<Transform>())
     {
         auto mesh = registry.GetComponent<Mesh>(e);
         if (!mesh)
             continue;
+        // a handful at most, so a scan beats a component lookup per entity
+        if (!overlayEntities.empty() && std::find(overlayEntities.begin(), overlayEntities.end(), e) != overlayEntities.end())
+            continue;
 
-        glm::mat4 modelMat = transform->GetMatrix();
-        // if entity is first-person, render it in camera (view) space so it stays fixed on-screen
-        if (registry.GetComponent<FirstPerson>(e))
+        DrawItem item;
+        MakeDrawItem(registry, e, mesh, transform->GetMatrix(), item);
+        item.depth = -(view * item.model[3]).z;
+        item.bucket = DepthBucket(item.depth);
+        // hidden draws can still cast a shadow into view, so only the draw is
+        // dropped. segments span every cell, so only the occlusion test applies
+        auto seg = registry.GetComponent<WorldSegment>(e);
+        if (!mesh->hasBounds ||
+            ((seg || PvsVisible(*mesh, item.model)) && occlusion.IsVisible(mesh->boundsMin, mesh->boundsMax, item.model)))
         {
-            // model in world space = inverse(view) * model_in_camera_space
-            modelMat = glm::inverse(view) * modelMat;
+            draws.push_back(item);
+            if (mesh->hasBounds && (seg || mesh->indexCount >= minQueryIndices))
+                TrackQuery(e, *mesh, draws.back());
         }
 
-        shader->SetMat4("model", &modelMat[0][0]);
-        // bind mesh VAO and check GL state
-        glBindVertexArray(mesh->vao);
-        GLenum err = glGetError();
-        if (err != GL_NO_ERROR)
+        // segment copies share one mesh and live in the static shadow layer;
+        // anything else but the main light's marker moves
+        if (seg)
         {
-            std::cerr << "RenderSystem: GL error after binding VAO for entity " << e << ": 0x" << std::hex << err << std::dec << std::endl;
+            if (!segmentMesh)
+            {
+                segmentMesh = mesh;
+                segment = *seg;
+                segmentPhase = transform->position.z;
+            }
+            continue;
         }
-        GLint useTexLoc = glGetUniformLocation(shader->id, "useTex");
-        GLint objColorLoc = glGetUniformLocation(shader->id, "objectColor");
+        auto light = registry.GetComponent<Light>(e);
+        if (!light || light->radius > 0.0f)
+            shadowCasters.push_back(item);
+    }
+    if (segmentMesh && segmentMesh->vao != segmentVao)
+    {
+        segmentVao = segmentMesh->vao;
+        shadows.InvalidateStatic();
+    }
+    std::sort(draws.begin(), draws.end(), [](const DrawItem &a, const DrawItem &b)
+              { return std::tie(a.bucket, a.features, a.mesh->textureArray, a.mesh->texture, a.mesh->lightmap, a.mesh->vao, a.depth) <
+                       std::tie(b.bucket, b.features, b.mesh->textureArray, b.mesh->texture, b.mesh->lightmap, b.mesh->vao, b.depth); });
+}
+
+bool RenderSystem::PvsVisible(const Mesh &mesh, const glm::mat4 &model)
+{
+    if (cameraCell < 0)
+        return true;
+    glm::vec3 lo, hi;
+    WorldBounds(mesh, model, lo, hi);
+    // anything reaching above the walls may be seen over them
+    if (hi.y >= wallTop || pvs->IsVisible(cameraCell, lo - pvsOrigin, hi - pvsOrigin))
+        return true;
+    ++pvsCulled;
+    return false;
+}
+
+void RenderSystem::TrackQuery(Entity e, const Mesh &mesh, DrawItem &item)
+{
+    glm::vec3 lo, hi;
+    WorldBounds(mesh, item.model, lo, hi);
+    const glm::vec3 &eye = frame.viewPos;
+    if (eye.x > lo.x - queryMargin && eye.y > lo.y - queryMargin && eye.z > lo.z - queryMargin &&
+        eye.x < hi.x + queryMargin && eye.y < hi.y + queryMargin && eye.z < hi.z + queryMargin)
+        return;
+    // conditional draws go one at a time
+    item.condition = queries.Condition(e);
+    item.instanceable = false;
+    queryTargets.push_back({e, lo, hi});
+}
+
+void RenderSystem::SubmitDraws(const std::vector<DrawItem> &items, const FrameUniforms &frame, bool depthOnly)
+{
+    // 2D textures live on unit 0, material arrays on unit 1, light clusters
+    // on 2-4, lightmaps on 5, shadow maps on 6-7. GLState drops the binds a
+    // run shares with the one before it.
 
-        if (mesh->texture)
+    Shader *current = nullptr;
+    uint32_t currentFeatures = ~0u;
+    std::vector<uint32_t> prepared; // variants whose frame uniforms are set
+    for (size_t i = 0; i < items.size();)
+    {
+        const DrawItem &first = items[i];
+        const Mesh &mesh = *first.mesh;
+
+        // a run shares variant, textures, VAO and color
+        size_t end = i + 1;
+        bool instanceable = first.instanceable;
+        while (end < items.size() && items[end].features == first.features && items[end].mesh->vao == mesh.vao &&
+               items[end].mesh->texture == mesh.texture && items[end].mesh->textureArray == mesh.textureArray &&
+               items[end].mesh->lightmap == mesh.lightmap && items[end].color == first.color)
         {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, mesh->texture);
-            GLint loc = glGetUniformLocation(shader->id, "tex0");
-            if (loc >= 0)
-                glUniform1i(loc, 0);
-            if (useTexLoc >= 0)
-                glUniform1i(useTexLoc, 1);
-            // ensure non-emitter by default
-            GLint isEmitterLoc = glGetUniformLocation(shader->id, "isEmitter");
-            if (isEmitterLoc >= 0)
-                glUniform1i(isEmitterLoc, 0);
+            instanceable = instanceable && items[end].instanceable;
+            ++end;
         }
-        else
+        size_t count = end - i;
+        bool instanced = instanceable && count >= minInstancedRun;
+
+        // depth-only items skip materials, so any run can use the plain variant
+        uint32_t features = (depthOnly ? 0 : first.features) | (instanced ? FeatureInstanced : 0);
+        if (features != currentFeatures)
         {
-            if (useTexLoc >= 0)
-                glUniform1i(useTexLoc, 0);
-            auto lightComp = registry.GetComponent<Light>(e);
-            if (lightComp)
-            {
-                if (objColorLoc >= 0)
-                    glUniform3f(objColorLoc, lightComp->color.r, lightComp->color.g, lightComp->color.b);
-            }
-            else
-            {
-                // use mesh color when no texture and no explicit light component
-                if (objColorLoc >= 0)
-                    glUniform3f(objColorLoc, mesh->color.r, mesh->color.g, mesh->color.b);
-            }
-            // if this mesh corresponds to a Light component, mark it as an emitter
-            auto l = lightComp;
-            GLint isEmitterLoc = glGetUniformLocation(shader->id, "isEmitter");
-            if (isEmitterLoc >= 0)
+            currentFeatures = features;
+            current = shaders.Get(features);
+            if (current)
             {
-                if (l)
-                    glUniform1i(isEmitterLoc, 1);
-                else
-                    glUniform1i(isEmitterLoc, 0);
+                current->Use();
+                if (std::find(prepared.begin(), prepared.end(), features) == prepared.end())
+                {
+                    ApplyFrameUniforms(*current, frame);
+                    prepared.push_back(features);
+                }
             }
         }
+        if (!current)
+        {
+            i = end;
+            continue;
+        }
 
-        // draw and check for errors (report entity and VAO/indexCount)
-        glDrawElements(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT, 0);
-        err = glGetError();
-        if (err != GL_NO_ERROR)
+        if (!depthOnly)
+        {
+            if (mesh.textureArray)
+                GLState::BindTexture(1, GL_TEXTURE_2D_ARRAY, mesh.textureArray);
+            else if (mesh.texture)
+                GLState::BindTexture(0, GL_TEXTURE_2D, mesh.texture);
+            if (mesh.lightmap)
+                GLState::BindTexture(lightmapUnit, GL_TEXTURE_2D, mesh.lightmap);
+            if (!(features & (FeatureTextured | FeatureTextureArray)))
+                current->SetVec3("objectColor", first.color);
+        }
+
+        GLState::BindVertexArray(mesh.vao);
+        if (instanced)
+        {
+            DrawInstanced(&items[i], count);
+        }
+        else
         {
-            std::cerr << "RenderSystem: GL error after glDrawElements for entity " << e << " (vao=" << mesh->vao << " idxCount=" << mesh->indexCount << "): 0x" << std::hex << err << std::dec << std::endl;
+            for (size_t k = i; k < end; ++k)
+            {
+                current->SetMat4("model", &items[k].model[0][0]);
+                current->SetMat3("normalMatrix", items[k].normal);
+                // last frame's result is always ready by now, so waiting costs
+                // nothing and the prepass and opaque pass agree
+                if (items[k].condition)
+                    glBeginConditionalRender(items[k].condition, GL_QUERY_WAIT);
+                glDrawElements(GL_TRIANGLES, items[k].mesh->indexCount, GL_UNSIGNED_INT, 0);
+                if (items[k].condition)
+                    glEndConditionalRender();
+            }
         }
-        glBindVertexArray(0);
+        i = end;
     }
-    GLenum err = glGetError();
-    if (err != GL_NO_ERROR)
-        std::cerr << "RenderSystem: GL error after mesh draws: 0x" << std::hex << err << std::dec << std::endl;
+}
+
+void RenderSystem::ApplyFrameUniforms(const Shader &shader, const FrameUniforms &frame) const
+{
+    shader.SetMat4("view", &frame.view[0][0]);
+    shader.SetMat4("proj", &frame.proj[0][0]);
+    shader.SetVec3("lightPos", frame.lightPos);
+    shader.SetVec3("lightColor", frame.lightColor);
+    shader.SetFloat("lightIntensity", frame.lightIntensity);
+    shader.SetVec3("viewPos", frame.viewPos);
+    shader.SetInt("tex0", 0);
+    shader.SetInt("texArray", 1);
+    shader.SetInt("lightmap", lightmapUnit);
+    shader.SetInt("clusterLights", clusterUnit);
+    shader.SetInt("clusterGrid", clusterUnit + 1);
+    shader.SetInt("clusterIndices", clusterUnit + 2);
+    // tile = pixel / tile size; slice = log(depth / near) * slices / log(far / near)
+    shader.SetVec3("clusterScale", glm::vec3(1.0f / frame.tileWidth, 1.0f / frame.tileHeight,
+                                             LightClusters::slices / std::log(zFar / zNear)));
+    shader.SetFloat("clusterNear", zNear);
+    shader.SetInt("staticShadow", shadowUnit);
+    shader.SetInt("dynamicShadow", shadowUnit + 1);
+    shader.SetInt("staticShadowOn", frame.staticShadows ? 1 : 0);
+    shader.SetInt("dynamicShadowOn", frame.dynamicShadows ? 1 : 0);
+    shader.SetMat4("staticShadowMatrix", &frame.staticShadowMatrix[0][0]);
+    shader.SetMat4("dynamicShadowMatrix", &frame.dynamicShadowMatrix[0][0]);
+    shader.SetMat4("toWorld", &frame.toWorld[0][0]);
+    shader.SetFloat("segmentPhase", frame.segmentPhase);
+    shader.SetFloat("segmentPeriod", frame.segmentPeriod);
+}
+
+void RenderSystem::DrawInstanced(const DrawItem *items, size_t count)
+{
+    instanceData.resize(count);
+    for (size_t k = 0; k < count; ++k)
+        instanceData[k] = {items[k].model, items[k].normal};
+
+    if (!instanceBuffer)
+        instanceBuffer = GpuHandle(GpuKind::Buffer, GpuResources::CreateBuffer("instance data"));
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.Get());
+    if (count > instanceCapacity)
+    {
+        instanceCapacity = count * 2;
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+        GpuResources::SetBytes(GpuKind::Buffer, instanceBuffer.Get(), instanceCapacity * sizeof(InstanceData));
+    }
+    else
+    {
+        // orphan so the driver need not wait on last frame's draws
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instanceData.data());
+
+    // the attributes live in the mesh VAO; respecified each time because VAO
+    // names are recycled when meshes are freed. model takes four vec4
+    // columns, the normal matrix three vec3 columns after it.
+    const GLsizei stride = sizeof(InstanceData);
+    for (GLuint c = 0; c < 4; ++c)
+    {
+        GLuint loc = instanceLocation + c;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, stride, (void *)(offsetof(InstanceData, model) + c * sizeof(glm::vec4)));
+        glVertexAttribDivisor(loc, 1);
+    }
+    for (GLuint c = 0; c < 3; ++c)
+    {
+        GLuint loc = instanceLocation + 4 + c;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, stride, (void *)(offsetof(InstanceData, normal) + c * sizeof(glm::vec3)));
+        glVertexAttribDivisor(loc, 1);
+    }
+    glDrawElementsInstanced(GL_TRIANGLES, items[0].mesh->indexCount, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(count));
 }
 
 void RenderSystem::Cleanup()
 {
-    delete shader;
+    shaders.Clear();
+    instanceBuffer.Reset();
+    clusters.Free();
+    shadows.Free();
+    queries.Free();
+    if (proxyBox.vao)
+        MeshLibrary::Release(proxyBox);
+    proxyBox = Mesh();
 }
@@ -1,52 +1,181 @@
 #include "ecs/Shader.hpp"
+#include "renderer/GLState.hpp"
+#include "renderer/GpuResources.hpp"
+#include "renderer/ProgramCache.hpp"
+#include <SDL3/SDL.h>
 #include <iostream>
 
-static GLuint Compile(GLenum type, const char *src)
+namespace
 {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &src, nullptr);
-    glCompileShader(shader);
+    // KHR_parallel_shader_compile, fetched by hand like the other post-3.3 entry points
+    typedef void(APIENTRYP MaxShaderCompilerThreadsFn)(GLuint count);
+    const GLenum completionStatus = 0x91B1; // GL_COMPLETION_STATUS_KHR
+    bool parallelCompile = false;
 
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    GLuint Compile(GLenum type, const char *src)
     {
-        char info[512];
-        glGetShaderInfoLog(shader, 512, nullptr, info);
-        std::cerr << "Shader compile error:\n"
-                  << info << std::endl;
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &src, nullptr);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    void ReportCompile(GLuint shader)
+    {
+        GLint success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            char info[512];
+            glGetShaderInfoLog(shader, 512, nullptr, info);
+            std::cerr << "Shader compile error:\n"
+                      << info << std::endl;
+        }
     }
-    return shader;
 }
 
-Shader::Shader(const char *vertexSrc, const char *fragmentSrc)
+void Shader::InitParallelCompile()
+{
+    parallelCompile = SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile");
+    if (!parallelCompile)
+        return;
+    // let the driver pick its thread count
+    auto maxThreads = reinterpret_cast<MaxShaderCompilerThreadsFn>(SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR"));
+    if (maxThreads)
+        maxThreads(0xFFFFFFFFu);
+    std::cerr << "Shader: compiling in parallel (KHR_parallel_shader_compile)" << std::endl;
+}
+
+bool Shader::ParallelCompile()
+{
+    return parallelCompile;
+}
+
+Shader::Shader(const char *vertexSrc, const char *fragmentSrc, const std::string &label)
 {
-    GLuint vs = Compile(GL_VERTEX_SHADER, vertexSrc);
-    GLuint fs = Compile(GL_FRAGMENT_SHADER, fragmentSrc);
+    id = GpuResources::CreateProgram(label);
+
+    // a cached binary skips compiling and linking entirely
+    cacheKey = ProgramCache::Key(vertexSrc, fragmentSrc);
+    if (ProgramCache::Load(id, cacheKey))
+    {
+        linked = true;
+        return;
+    }
 
-    id = glCreateProgram();
+    // no status queries here: they would wait for the compiler
+    vs = Compile(GL_VERTEX_SHADER, vertexSrc);
+    fs = Compile(GL_FRAGMENT_SHADER, fragmentSrc);
     glAttachShader(id, vs);
     glAttachShader(id, fs);
+    ProgramCache::PrepareForLink(id);
     glLinkProgram(id);
+    pending = true;
+}
+
+bool Shader::Poll()
+{
+    if (!pending)
+        return true;
+    if (parallelCompile)
+    {
+        GLint done = GL_FALSE;
+        glGetProgramiv(id, completionStatus, &done);
+        if (!done)
+            return false;
+    }
+    Finish();
+    return true;
+}
+
+void Shader::Wait()
+{
+    if (pending)
+        Finish();
+}
+
+void Shader::Use()
+{
+    Wait();
+    GLState::UseProgram(id);
+}
+
+void Shader::Finish()
+{
+    pending = false;
 
-    GLint linked;
-    glGetProgramiv(id, GL_LINK_STATUS, &linked);
+    GLint ok;
+    glGetProgramiv(id, GL_LINK_STATUS, &ok);
+    linked = ok == GL_TRUE;
     if (!linked)
     {
+        ReportCompile(vs);
+        ReportCompile(fs);
         char info[512];
         glGetProgramInfoLog(id, 512, nullptr, info);
         std::cerr << "Program link error:\n"
                   << info << std::endl;
     }
 
+    glDetachShader(id, vs);
+    glDetachShader(id, fs);
     glDeleteShader(vs);
     glDeleteShader(fs);
+    vs = fs = 0;
+
+    if (linked)
+        ProgramCache::Store(id, cacheKey);
+}
+
+Shader::~Shader()
+{
+    // still compiling: the shader objects are ours to delete
+    if (vs)
+        glDeleteShader(vs);
+    if (fs)
+        glDeleteShader(fs);
+    GpuResources::Destroy(GpuKind::Program, id);
 }
 
-Shader::~Shader() { glDeleteProgram(id); }
+GLint Shader::Uniform(const std::string &name) const
+{
+    auto it = uniforms.find(name);
+    if (it != uniforms.end())
+        return it->second;
+    GLint loc = glGetUniformLocation(id, name.c_str());
+    uniforms.emplace(name, loc);
+    return loc;
+}
 
 void Shader::SetMat4(const std::string &name, const float *value) const
 {
-    GLint loc = glGetUniformLocation(id, name.c_str());
-    glUniformMatrix4fv(loc, 1, GL_FALSE, value);
+    glUniformMatrix4fv(Uniform(name), 1, GL_FALSE, value);
+}
+
+void Shader::SetMat3(const std::string &name, const glm::mat3 &value) const
+{
+    GLint loc = Uniform(name);
+    if (loc >= 0)
+        glUniformMatrix3fv(loc, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::SetVec3(const std::string &name, const glm::vec3 &value) const
+{
+    GLint loc = Uniform(name);
+    if (loc >= 0)
+        glUniform3f(loc, value.x, value.y, value.z);
+}
+
+void Shader::SetFloat(const std::string &name, float value) const
+{
+    GLint loc = Uniform(name);
+    if (loc >= 0)
+        glUniform1f(loc, value);
+}
+
+void Shader::SetInt(const std::string &name, int value) const
+{
+    GLint loc = Uniform(name);
+    if (loc >= 0)
+        glUniform1i(loc, value);
 }
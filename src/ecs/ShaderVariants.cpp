@@ -0,0 +1,136 @@
+#include "ecs/ShaderVariants.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+namespace
+{
+    const struct
+    {
+        uint32_t bit;
+        const char *name;
+    } featureNames[] = {
+        {FeatureTextured, "TEXTURED"},
+        {FeatureTextureArray, "TEXTURE_ARRAY"},
+        {FeatureEmissive, "EMISSIVE"},
+        {FeatureInstanced, "INSTANCED"},
+        {FeatureLightmapped, "LIGHTMAPPED"},
+    };
+
+    std::string ReadFile(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        if (!in)
+            return {};
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        return ss.str();
+    }
+}
+
+bool ShaderVariants::Load(const std::string &vertexPath, const std::string &fragmentPath)
+{
+    variants.clear();
+    vertexSrc = ReadFile(vertexPath);
+    fragmentSrc = ReadFile(fragmentPath);
+    name = vertexPath + " + " + fragmentPath;
+    if (!Loaded())
+    {
+        std::cerr << "ShaderVariants: failed to load " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+Shader *ShaderVariants::Submit(uint32_t features)
+{
+    auto it = variants.find(features);
+    if (it != variants.end())
+        return it->second.get();
+    if (!Loaded())
+        return nullptr;
+
+    std::string defines = Defines(features);
+    std::string vs = Inject(vertexSrc, defines);
+    std::string fs = Inject(fragmentSrc, defines);
+    auto shader = std::make_unique<Shader>(vs.c_str(), fs.c_str(), "shader variant 0x" + std::to_string(features));
+    Shader *result = shader.get();
+    variants.emplace(features, std::move(shader));
+    return result;
+}
+
+Shader *ShaderVariants::Check(std::unordered_map<uint32_t, std::unique_ptr<Shader>>::iterator it)
+{
+    if (it->second && !it->second->Linked())
+    {
+        std::cerr << "ShaderVariants: variant of " << name << " with [" << Defines(it->first) << "] failed to link" << std::endl;
+        it->second.reset();
+    }
+    return it->second.get();
+}
+
+Shader *ShaderVariants::Get(uint32_t features)
+{
+    if (!Submit(features))
+    {
+        auto it = variants.find(features);
+        return it != variants.end() ? it->second.get() : nullptr;
+    }
+    auto it = variants.find(features);
+    it->second->Wait();
+    return Check(it);
+}
+
+void ShaderVariants::Prewarm(const std::vector<uint32_t> &featureSets)
+{
+    for (uint32_t features : featureSets)
+        Submit(features);
+}
+
+void ShaderVariants::Poll()
+{
+    for (auto it = variants.begin(); it != variants.end(); ++it)
+    {
+        if (it->second && it->second->Poll())
+            Check(it);
+    }
+}
+
+size_t ShaderVariants::Pending() const
+{
+    size_t pending = 0;
+    for (auto &[features, shader] : variants)
+    {
+        if (shader && !shader->Linked())
+            ++pending;
+    }
+    return pending;
+}
+
+std::string ShaderVariants::Defines(uint32_t features)
+{
+    std::string out;
+    for (const auto &f : featureNames)
+    {
+        if (features & f.bit)
+            out += std::string("#define ") + f.name + "\n";
+    }
+    return out;
+}
+
+std::string ShaderVariants::Inject(const std::string &source, const std::string &defines)
+{
+    if (defines.empty())
+        return source;
+    // #version must stay the first statement
+    size_t version = source.find("#version");
+    if (version == std::string::npos)
+        return defines + source;
+    size_t eol = source.find('\n', version);
+    if (eol == std::string::npos)
+        return source + "\n" + defines;
+    // keep compiler messages pointing at the lines of the file on disk
+    size_t nextLine = std::count(source.begin(), source.begin() + eol + 1, '\n') + 1;
+    return source.substr(0, eol + 1) + defines + "#line " + std::to_string(nextLine) + "\n" + source.substr(eol + 1);
+}
@@ -1,14 +1,23 @@
 #include "ecs/SkyboxSystem.hpp"
-#include <stb_image.h>
+#include "ecs/AsyncTextureLoader.hpp"
 #include "ecs/Registry.hpp"
 #include "ecs/Camera.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <imgui.h>
+#include "ecs/ImageUtils.hpp"
+#include "renderer/GLState.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <iostream>
 
+namespace fs = std::filesystem;
+
 // cube for drawing skybox (positions only)
 static const float skyboxVerts[] = {
     -1.0f, 1.0f, -1.0f,
@@ -55,14 +64,15 @@ static const float skyboxVerts[] = {
 
 SkyboxSystem::SkyboxSystem()
 {
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    vao = GpuHandle(GpuKind::VertexArray, GpuResources::CreateVertexArray("skybox"));
+    vbo = GpuHandle(GpuKind::Buffer, GpuResources::CreateBuffer("skybox vertices"));
+    GLState::BindVertexArray(vao.Get());
+    glBindBuffer(GL_ARRAY_BUFFER, vbo.Get());
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVerts), skyboxVerts, GL_STATIC_DRAW);
+    GpuResources::SetBytes(GpuKind::Buffer, vbo.Get(), sizeof(skyboxVerts));
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-    glBindVertexArray(0);
+    GLState::BindVertexArray(0);
 
     // load skybox shader
     std::ifstream inv("data/shaders/skybox_vert.glsl");
@@ -85,107 +95,256 @@ SkyboxSystem::~SkyboxSystem()
     Cleanup();
 }
 
-// helper: copy a rectangular region from src (w x h, channels) into dst (fw x fh)
-static void CopyRegion(const unsigned char *src, int srcW, int srcH, int channels,
-                       int col, int row, int cols, int rows,
-                       unsigned char *dst, int fw, int fh)
+namespace
 {
-    int faceW = fw;
-    int faceH = fh;
-    int srcFaceW = srcW / cols;
-    int srcFaceH = srcH / rows;
-    int startX = col * srcFaceW;
-    int startY = row * srcFaceH;
-
-    for (int y = 0; y < srcFaceH; ++y)
+    // expect 4x3 grid
+    const int crossCols = 4;
+    const int crossRows = 3;
+
+    // mapping for this cross image layout:
+    const std::pair<int, int> faceCoords[6] = {
+        {2, 1}, // +X (right)
+        {0, 1}, // -X (left)
+        {1, 0}, // +Y (top)
+        {1, 2}, // -Y (bottom)
+        {1, 1}, // +Z (front)
+        {3, 1}  // -Z (back)
+    };
+
+    // baked cubemap: header, then every mip level, each holding the six faces in GL order
+    struct BakedHeader
     {
-        for (int x = 0; x < srcFaceW; ++x)
-        {
-            int sx = startX + x;
-            int sy = startY + y;
-            int sidx = (sy * srcW + sx) * channels;
-            int didx = (y * srcFaceW + x) * channels;
-            for (int c = 0; c < channels; ++c)
-                dst[didx + c] = src[sidx + c];
-        }
+        char magic[4] = {'D', 'S', 'K', 'Y'};
+        uint32_t version = 1;
+        uint32_t faceW = 0;
+        uint32_t faceH = 0;
+        uint32_t channels = 0;
+        uint32_t levels = 0;
+    };
+
+    GLenum FormatFor(int channels)
+    {
+        if (channels == 1)
+            return GL_RED;
+        if (channels == 4)
+            return GL_RGBA;
+        return GL_RGB;
+    }
+
+    bool IsBakedCurrent(const std::string &crossPath, const std::string &bakedPath)
+    {
+        std::error_code ec;
+        if (bakedPath.empty() || !fs::exists(bakedPath, ec))
+            return false;
+        if (!fs::exists(crossPath, ec))
+            return true;
+        return fs::last_write_time(bakedPath, ec) >= fs::last_write_time(crossPath, ec);
     }
 }
 
 bool SkyboxSystem::LoadFromCrossImage(const std::string &path)
 {
-    int width, height, channels;
     // don't flip -- we want rows as in file
-    stbi_set_flip_vertically_on_load(0);
-    unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 0);
-    if (!data)
+    DecodedImage image;
+    if (!Texture::Decode(path, false, image))
     {
         std::cerr << "SkyboxSystem: failed to load " << path << std::endl;
         return false;
     }
+    return UploadCrossImage(image);
+}
 
-    // expect 4x3 grid
-    const int cols = 4;
-    const int rows = 3;
-    if (width % cols != 0 || height % rows != 0)
+void SkyboxSystem::LoadFromCrossImageAsync(const std::string &path, const std::string &bakedPath)
+{
+    // nothing is drawn until the cubemap exists, so the clear color is the placeholder
+    if (IsBakedCurrent(path, bakedPath))
+    {
+        auto bytes = std::make_shared<std::vector<char>>();
+        AsyncTextureLoader::RunOnWorker([bytes, bakedPath]()
+                                        {
+            std::ifstream in(bakedPath, std::ios::binary);
+            bytes->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()); },
+                                        [this, bytes, path, bakedPath]()
+                                        {
+            if (UploadBaked(*bytes, bakedPath))
+                return;
+            // drop the bad bake so this decodes the cross image and writes a fresh one
+            std::cerr << "SkyboxSystem: rejected baked cubemap " << bakedPath << ", rebaking" << std::endl;
+            std::error_code ec;
+            fs::remove(bakedPath, ec);
+            if (ec)
+            {
+                std::cerr << "SkyboxSystem: could not delete " << bakedPath << ": " << ec.message() << std::endl;
+                AsyncTextureLoader::Submit(path, false, [this](DecodedImage &image)
+                                           { UploadCrossImage(image); });
+                return;
+            }
+            LoadFromCrossImageAsync(path, bakedPath); });
+        return;
+    }
+
+    AsyncTextureLoader::Submit(path, false, [this, bakedPath](DecodedImage &image)
+                               {
+        if (!UploadCrossImage(image) || bakedPath.empty())
+            return;
+        // write the baked faces in the background so the next launch skips decoding
+        auto cross = std::make_shared<DecodedImage>(std::move(image));
+        AsyncTextureLoader::RunOnWorker([cross, bakedPath]()
+                                        { BakeCrossImage(*cross, bakedPath); },
+                                        [] {}); });
+}
+
+bool SkyboxSystem::UploadCrossImage(const DecodedImage &image)
+{
+    const std::string &path = image.path;
+    int width = image.width;
+    int height = image.height;
+    int channels = image.channels;
+
+    if (width % crossCols != 0 || height % crossRows != 0)
     {
         std::cerr << "SkyboxSystem: image size not divisible by 4x3 grid: " << width << "x" << height << std::endl;
-        stbi_image_free(data);
         return false;
     }
 
-    faceW = width / cols;
-    faceH = height / rows;
+    faceW = width / crossCols;
+    faceH = height / crossRows;
 
     // allocate and create cubemap
-    glGenTextures(1, &cubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+    cubemap = GpuHandle(GpuKind::Texture, GpuResources::CreateTexture(path));
+    GLState::BindTexture(0, GL_TEXTURE_CUBE_MAP, cubemap.Get());
 
-    // mapping for this cross image layout:
-    std::pair<int, int> faceCoords[6] = {
-        {2, 1}, // +X (right)
-        {0, 1}, // -X (left)
-        {1, 0}, // +Y (top)
-        {1, 2}, // -Y (bottom)
-        {1, 1}, // +Z (front)
-        {3, 1}  // -Z (back)
-    };
+    // upload each face straight out of the cross image: the unpack state selects
+    // the face rectangle, so no per-face copy is needed
+    GLenum format = FormatFor(channels);
+    GLState::UnpackAlignment(1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    for (int i = 0; i < 6; ++i)
+    {
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, faceCoords[i].first * faceW);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, faceCoords[i].second * faceH);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, faceW, faceH, 0, format, GL_UNSIGNED_BYTE, image.pixels.data());
+    }
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
-    int faceSize = faceW * faceH * channels;
-    std::vector<unsigned char> faceBuf(faceSize);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    GpuResources::SetBytes(GpuKind::Texture, cubemap.Get(), static_cast<size_t>(faceW) * faceH * 4 * 6);
+    std::cerr << "SkyboxSystem: loaded cross image " << path << " (" << width << "x" << height << ") -> face " << faceW << "x" << faceH << std::endl;
+    return true;
+}
+
+bool SkyboxSystem::BakeCrossImage(const DecodedImage &cross, const std::string &outPath)
+{
+    if (cross.width % crossCols != 0 || cross.height % crossRows != 0)
+        return false;
+
+    int fw = cross.width / crossCols;
+    int fh = cross.height / crossRows;
 
+    // split once, then build each face's mip chain
+    std::vector<std::vector<DecodedImage>> chains(6);
     for (int i = 0; i < 6; ++i)
     {
-        int col = faceCoords[i].first;
-        int row = faceCoords[i].second;
-        CopyRegion(data, width, height, channels, col, row, cols, rows, faceBuf.data(), faceW, faceH);
+        chains[i].push_back(ImageUtils::Extract(cross, faceCoords[i].first * fw, faceCoords[i].second * fh, fw, fh));
+        while (chains[i].back().width > 1 || chains[i].back().height > 1)
+            chains[i].push_back(ImageUtils::Downsample(chains[i].back()));
+    }
 
-        GLenum format = GL_RGB;
-        if (channels == 1)
-            format = GL_RED;
-        else if (channels == 3)
-            format = GL_RGB;
-        else if (channels == 4)
-            format = GL_RGBA;
-
-        // upload to cubemap face
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, faceW, faceH, 0, format, GL_UNSIGNED_BYTE, faceBuf.data());
+    BakedHeader header;
+    header.faceW = fw;
+    header.faceH = fh;
+    header.channels = cross.channels;
+    header.levels = static_cast<uint32_t>(chains[0].size());
+
+    std::string tmpPath = outPath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary);
+        if (!out)
+            return false;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (uint32_t level = 0; level < header.levels; ++level)
+        {
+            for (int i = 0; i < 6; ++i)
+            {
+                const auto &px = chains[i][level].pixels;
+                out.write(reinterpret_cast<const char *>(px.data()), px.size());
+            }
+        }
+        if (!out)
+            return false;
     }
+    std::error_code ec;
+    fs::rename(tmpPath, outPath, ec);
+    return !ec;
+}
 
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+bool SkyboxSystem::UploadBaked(const std::vector<char> &bytes, const std::string &path)
+{
+    BakedHeader expected;
+    BakedHeader header;
+    if (bytes.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, expected.magic, 4) != 0 || header.version != expected.version ||
+        header.faceW == 0 || header.faceH == 0 || header.levels == 0 || header.channels == 0 || header.channels > 4)
+        return false;
+
+    // validate the size before touching GL
+    size_t total = sizeof(header);
+    for (uint32_t level = 0, w = header.faceW, h = header.faceH; level < header.levels; ++level)
+    {
+        total += static_cast<size_t>(w) * h * header.channels * 6;
+        w = std::max(1u, w / 2);
+        h = std::max(1u, h / 2);
+    }
+    if (bytes.size() < total)
+        return false;
+
+    faceW = header.faceW;
+    faceH = header.faceH;
+    cubemap = GpuHandle(GpuKind::Texture, GpuResources::CreateTexture(path));
+    GLState::BindTexture(0, GL_TEXTURE_CUBE_MAP, cubemap.Get());
+    GLState::UnpackAlignment(1);
+
+    GLenum format = FormatFor(header.channels);
+    const char *cursor = bytes.data() + sizeof(header);
+    size_t uploaded = 0;
+    for (uint32_t level = 0, w = header.faceW, h = header.faceH; level < header.levels; ++level)
+    {
+        size_t faceBytes = static_cast<size_t>(w) * h * header.channels;
+        for (int i = 0; i < 6; ++i)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, format, w, h, 0, format, GL_UNSIGNED_BYTE, cursor);
+            cursor += faceBytes;
+        }
+        uploaded += static_cast<size_t>(w) * h * 4 * 6;
+        w = std::max(1u, w / 2);
+        h = std::max(1u, h / 2);
+    }
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, header.levels - 1);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-    stbi_image_free(data);
-    std::cerr << "SkyboxSystem: loaded cross image " << path << " (" << width << "x" << height << ") -> face " << faceW << "x" << faceH << std::endl;
+    GpuResources::SetBytes(GpuKind::Texture, cubemap.Get(), uploaded);
+    std::cerr << "SkyboxSystem: loaded baked cubemap " << path << " (face " << faceW << "x" << faceH << ", " << header.levels << " levels)" << std::endl;
     return true;
 }
 
 void SkyboxSystem::Update(Registry &registry, float dt)
 {
-    if (!shader || shader->id == 0 || cubemap == 0)
+    if (!shader || shader->id == 0 || !cubemap)
         return;
 
     // get camera view matrix
@@ -201,27 +360,33 @@ void SkyboxSystem::Update(Registry &registry, float dt)
     float width = io.DisplaySize.x > 0.0f ? io.DisplaySize.x : 800.0f;
     float height = io.DisplaySize.y > 0.0f ? io.DisplaySize.y : 600.0f;
     glm::mat4 proj = glm::perspective(glm::radians(45.0f), width / height, 0.1f, 100.0f);
+    Draw(view, proj);
+}
+
+void SkyboxSystem::Draw(const glm::mat4 &view, const glm::mat4 &proj)
+{
+    if (!shader || shader->id == 0 || !cubemap)
+        return;
 
-    glDepthFunc(GL_LEQUAL);
-    glDepthMask(GL_FALSE);
+    GLState::DepthFunc(GL_LEQUAL);
+    GLState::DepthMask(false);
+    // the cube is seen from inside
+    GLState::Disable(GL_CULL_FACE);
 
     shader->Use();
     glm::mat4 viewNoTrans = glm::mat4(glm::mat3(view));
     shader->SetMat4("view", &viewNoTrans[0][0]);
     shader->SetMat4("proj", &proj[0][0]);
 
-    glBindVertexArray(vao);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
-    GLint loc = glGetUniformLocation(shader->id, "skybox");
-    if (loc >= 0)
-        glUniform1i(loc, 0);
+    shader->SetInt("skybox", 0);
 
+    GLState::BindVertexArray(vao.Get());
+    GLState::BindTexture(0, GL_TEXTURE_CUBE_MAP, cubemap.Get());
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
 
-    glDepthMask(GL_TRUE);
-    glDepthFunc(GL_LESS);
+    GLState::Enable(GL_CULL_FACE);
+    GLState::DepthMask(true);
+    GLState::DepthFunc(GL_LESS);
 }
 
 void SkyboxSystem::Cleanup()
@@ -231,19 +396,7 @@ void SkyboxSystem::Cleanup()
         delete shader;
         shader = nullptr;
     }
-    if (vbo)
-    {
-        glDeleteBuffers(1, &vbo);
-        vbo = 0;
-    }
-    if (vao)
-    {
-        glDeleteVertexArrays(1, &vao);
-        vao = 0;
-    }
-    if (cubemap)
-    {
-        glDeleteTextures(1, &cubemap);
-        cubemap = 0;
-    }
+    vbo.Reset();
+    vao.Reset();
+    cubemap.Reset();
 }
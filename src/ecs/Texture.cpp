@@ -1,66 +1,280 @@
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
 #include "ecs/Texture.hpp"
+#include "renderer/GLState.hpp"
+#include "renderer/GpuResources.hpp"
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
 #include <iostream>
 
-// cringe
-extern "C" void stbi_set_flip_vertically_on_load(int);
+namespace fs = std::filesystem;
 
-GLuint Texture::Load(const std::string &path)
+namespace
 {
-    int width, height, channels;
-    stbi_set_flip_vertically_on_load(1);
-    unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 0);
-    if (!data)
+    // sRGB counterparts of the formats texbake writes
+    GLenum SrgbFormat(GLenum internalFormat)
     {
-        std::cerr << "Failed to load image: " << path << std::endl;
-        return 0;
+        switch (internalFormat)
+        {
+        case Ktx::Rgb8:
+            return GL_SRGB8;
+        case Ktx::Rgba8:
+            return GL_SRGB8_ALPHA8;
+        case Ktx::Bc1:
+            return 0x8C4C; // GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+        case Ktx::Bc3:
+            return 0x8C4F; // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+        default:
+            return internalFormat;
+        }
     }
 
-    GLenum format = GL_RGB;
-    GLenum internalFormat = GL_RGB;
-    if (channels == 1)
+    TextureBudget budget;
+
+    // the byte limit never shrinks a texture below this
+    const int minBudgetDimension = 32;
+
+    bool IsCurrent(const std::string &baked, const std::string &source)
     {
-        format = GL_RED;
-        internalFormat = GL_R8;
+        std::error_code ec;
+        if (!fs::exists(baked, ec))
+            return false;
+        if (!fs::exists(source, ec))
+            return true;
+        return fs::last_write_time(baked, ec) >= fs::last_write_time(source, ec);
     }
-    else if (channels == 3)
+
+    // level 0 plus sampler settings; leaves tex bound to unit 0
+    void Specify(GLuint tex, int width, int height, int channels, const void *pixels, const TextureSettings &settings)
+    {
+        GLenum format = GL_RGB;
+        GLenum internalFormat = GL_RGB;
+        if (channels == 1)
+        {
+            format = GL_RED;
+            internalFormat = GL_R8;
+        }
+        else if (channels == 3)
+        {
+            format = GL_RGB;
+            internalFormat = settings.srgb ? GL_SRGB8 : GL_RGB8;
+        }
+        else if (channels == 4)
+        {
+            format = GL_RGBA;
+            internalFormat = settings.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        }
+
+        GLState::BindTexture(0, GL_TEXTURE_2D, tex);
+
+        // tightly packed rows; the alignment stays tracked, so the next upload
+        // that needs 4 sets it back
+        GLState::UnpackAlignment(1);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, settings.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, settings.magFilter);
+
+        GpuResources::SetBytes(GpuKind::Texture, tex, Texture::EstimateBytes(width, height, channels));
+    }
+}
+
+bool Texture::Decode(const std::string &path, bool flip, DecodedImage &out)
+{
+    return ImageUtils::Decode(path, flip, out);
+}
+
+void Texture::Upload(GLuint tex, const DecodedImage &image, const TextureSettings &settings)
+{
+    Upload(tex, image.width, image.height, image.channels, image.pixels.data(), settings);
+}
+
+void Texture::Upload(GLuint tex, int width, int height, int channels, const void *pixels, const TextureSettings &settings)
+{
+    Specify(tex, width, height, channels, pixels, settings);
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+void Texture::Allocate(GLuint tex, int width, int height, int channels, const TextureSettings &settings)
+{
+    Specify(tex, width, height, channels, nullptr, settings);
+}
+
+void Texture::Upload(GLuint tex, const Ktx::Image &image, const TextureSettings &settings)
+{
+    GLenum internalFormat = settings.srgb ? SrgbFormat(image.glInternalFormat) : image.glInternalFormat;
+    int stored = static_cast<int>(image.levels.size());
+
+    // bytes of each level and everything below it, as stored (BC blocks included)
+    std::vector<size_t> chainBytes(stored + 1, 0);
+    for (int level = stored - 1; level >= 0; --level)
+        chainBytes[level] = chainBytes[level + 1] + image.levels[level].size();
+
+    // over budget: drop top levels, the next level down becomes level 0
+    size_t available = AvailableBytes();
+    int first = 0;
+    int w = image.width, h = image.height;
+    for (; first + 1 < stored; ++first)
     {
-        format = GL_RGB;
-        internalFormat = GL_SRGB8;
+        bool tooBig = budget.maxDimension > 0 && std::max(w, h) > budget.maxDimension;
+        bool tooHeavy = chainBytes[first] > available && std::max(w, h) > minBudgetDimension;
+        if (!tooBig && !tooHeavy)
+            break;
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
     }
-    else if (channels == 4)
+    if (first > 0)
+        std::cerr << "Texture: skipped " << first << " mip levels of " << image.width << "x" << image.height << ", now " << w << "x" << h << std::endl;
+
+    GLState::BindTexture(0, GL_TEXTURE_2D, tex);
+    // uncompressed KTX rows are padded to an alignment of 4
+    GLState::UnpackAlignment(4);
+    int levels = stored - first;
+    size_t bytes = 0;
+    for (int level = 0; level < levels; ++level)
     {
-        format = GL_RGBA;
-        internalFormat = GL_SRGB8_ALPHA8;
+        const auto &data = image.levels[first + level];
+        if (image.IsCompressed())
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, w, h, 0, static_cast<GLsizei>(data.size()), data.data());
+            bytes += data.size();
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, internalFormat, w, h, 0, image.glFormat, image.glType, data.data());
+            bytes += static_cast<size_t>(w) * h * (image.glFormat == Ktx::Red ? 1 : 4);
+        }
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
     }
 
-    GLuint tex;
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, settings.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, settings.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, settings.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, settings.magFilter);
 
-    GLint prevAlignment = 4;
-    glGetIntegerv(GL_UNPACK_ALIGNMENT, &prevAlignment);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    GpuResources::SetBytes(GpuKind::Texture, tex, bytes);
+}
 
-    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+void Texture::SetBudget(const TextureBudget &b)
+{
+    budget = b;
+}
 
-    // restore unpack alignment
-    glPixelStorei(GL_UNPACK_ALIGNMENT, prevAlignment);
-    glGenerateMipmap(GL_TEXTURE_2D);
+const TextureBudget &Texture::GetBudget()
+{
+    return budget;
+}
+
+size_t Texture::AvailableBytes()
+{
+    if (budget.maxTotalBytes == 0)
+        return SIZE_MAX;
+    size_t used = GpuResources::Bytes(GpuKind::Texture);
+    return used < budget.maxTotalBytes ? budget.maxTotalBytes - used : 0;
+}
+
+size_t Texture::EstimateBytes(int width, int height, int channels)
+{
+    // drivers pad RGB to 4 bytes per texel; the mip chain adds roughly a third
+    size_t texelBytes = channels == 1 ? 1 : 4;
+    return static_cast<size_t>(width) * height * texelBytes * 4 / 3;
+}
+
+int Texture::FitToBudget(DecodedImage &image, const TextureBudget &limits, size_t availableBytes)
+{
+    int srcW = image.width, srcH = image.height;
+    int dropped = 0;
+    for (;;)
+    {
+        int longest = std::max(image.width, image.height);
+        bool tooBig = limits.maxDimension > 0 && longest > limits.maxDimension;
+        bool tooHeavy = EstimateBytes(image.width, image.height, image.channels) > availableBytes && longest > minBudgetDimension;
+        if ((!tooBig && !tooHeavy) || longest <= 1)
+            break;
+        image = ImageUtils::Downsample(image);
+        ++dropped;
+    }
+    if (dropped)
+        std::cerr << "Texture: " << image.path << " downscaled " << srcW << "x" << srcH << " -> " << image.width << "x" << image.height
+                  << " (" << EstimateBytes(image.width, image.height, image.channels) / 1024 << " KB)" << std::endl;
+    return dropped;
+}
+
+bool Texture::SupportsS3tc()
+{
+    static const bool supported = SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc");
+    return supported;
+}
+
+std::string Texture::FindBaked(const std::string &path)
+{
+    if (SupportsS3tc())
+    {
+        std::string compressed = Ktx::PathFor(path, true);
+        if (IsCurrent(compressed, path))
+            return compressed;
+    }
+    std::string plain = Ktx::PathFor(path, false);
+    if (IsCurrent(plain, path))
+        return plain;
+    return "";
+}
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+GLuint Texture::Load(const std::string &path, const TextureSettings &settings)
+{
+    std::string baked = FindBaked(path);
+    Ktx::Image ktx;
+    if (!baked.empty() && Ktx::Read(baked, ktx))
+    {
+        GLuint tex = GpuResources::CreateTexture(path);
+        Upload(tex, ktx, settings);
+        return tex;
+    }
+
+    DecodedImage image;
+    if (!Decode(path, true, image))
+        return 0;
+    FitToBudget(image, budget, AvailableBytes());
 
-    glBindTexture(GL_TEXTURE_2D, 0);
-    stbi_image_free(data);
+    GLuint tex = GpuResources::CreateTexture(path);
+    Upload(tex, image, settings);
     return tex;
 }
 
+GLuint Texture::CreatePlaceholder(const std::string &label, const TextureSettings &settings)
+{
+    DecodedImage grey;
+    grey.width = 1;
+    grey.height = 1;
+    grey.channels = 3;
+    grey.pixels = {128, 128, 128};
+
+    GLuint tex = GpuResources::CreateTexture(label);
+    Upload(tex, grey, settings);
+    return tex;
+}
+
+void Texture::UploadMissing(GLuint tex, const TextureSettings &settings)
+{
+    DecodedImage checker;
+    checker.width = 2;
+    checker.height = 2;
+    checker.channels = 3;
+    checker.pixels = {255, 0, 255, 0, 0, 0,
+                      0, 0, 0, 255, 0, 255};
+
+    TextureSettings nearest = settings;
+    nearest.minFilter = GL_NEAREST;
+    nearest.magFilter = GL_NEAREST;
+    Upload(tex, checker, nearest);
+}
+
 void Texture::Free(GLuint id)
 {
-    if (id)
-        glDeleteTextures(1, &id);
+    GpuResources::Destroy(GpuKind::Texture, id);
 }
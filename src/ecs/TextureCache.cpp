@@ -0,0 +1,143 @@
+#include "ecs/TextureCache.hpp"
+#include "ecs/AsyncTextureLoader.hpp"
+#include "renderer/GpuResources.hpp"
+#include <filesystem>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct TextureKey
+    {
+        std::string path;
+        TextureSettings settings;
+
+        bool operator<(const TextureKey &o) const
+        {
+            return std::tie(path, settings.wrap, settings.minFilter, settings.magFilter, settings.srgb) <
+                   std::tie(o.path, o.settings.wrap, o.settings.minFilter, o.settings.magFilter, o.settings.srgb);
+        }
+    };
+
+    struct TextureEntry
+    {
+        GLuint tex = 0;
+        int refs = 0;
+        bool failed = false; // async decode failed; tex shows the missing-image checker
+    };
+
+    std::map<TextureKey, TextureEntry> entries;
+    std::unordered_map<GLuint, TextureKey> keyByTex;
+    TextureCache::Stats stats;
+
+    std::string CanonicalPath(const std::string &path)
+    {
+        std::error_code ec;
+        fs::path p = fs::weakly_canonical(fs::path(path), ec);
+        return ec ? path : p.string();
+    }
+
+    void FreeEntry(std::map<TextureKey, TextureEntry>::iterator it)
+    {
+        keyByTex.erase(it->second.tex);
+        AsyncTextureLoader::Cancel(it->second.tex);
+        Texture::Free(it->second.tex);
+        entries.erase(it);
+    }
+}
+
+GLuint TextureCache::Acquire(const std::string &path, const TextureSettings &settings)
+{
+    TextureKey key{CanonicalPath(path), settings};
+    auto it = entries.find(key);
+    // a failed async load nobody holds any more is retried, like a cached 0 after Trim
+    if (it != entries.end() && it->second.failed && it->second.refs == 0)
+    {
+        FreeEntry(it);
+        it = entries.end();
+    }
+    if (it != entries.end())
+    {
+        ++stats.hits;
+        ++it->second.refs;
+        GpuResources::Touch(GpuKind::Texture, it->second.tex);
+        return it->second.tex;
+    }
+
+    ++stats.misses;
+    TextureEntry entry;
+    // with the async loader running, decoding happens off-thread and a placeholder
+    // is bound meanwhile. missing files still fail here so callers can fall back.
+    if (AsyncTextureLoader::IsRunning())
+    {
+        if (fs::exists(key.path))
+            entry.tex = AsyncTextureLoader::Request(key.path, settings, [](GLuint tex)
+                                                    {
+                auto k = keyByTex.find(tex);
+                if (k == keyByTex.end())
+                    return;
+                entries[k->second].failed = true;
+                ++stats.failures; });
+        else
+            std::cerr << "Failed to load image: " << key.path << std::endl;
+    }
+    else
+        entry.tex = Texture::Load(key.path, settings);
+    entry.refs = 1;
+    if (!entry.tex)
+        ++stats.failures;
+    entries.emplace(key, entry);
+    if (!entry.tex)
+        return 0;
+
+    keyByTex[entry.tex] = key;
+    // images can be decoded again from disk, so unreferenced ones may be evicted
+    GpuResources::SetReloadable(GpuKind::Texture, entry.tex, [key]()
+                                {
+        auto e = entries.find(key);
+        if (e == entries.end() || e->second.refs > 0)
+            return false;
+        FreeEntry(e);
+        return true; });
+    return entry.tex;
+}
+
+void TextureCache::Release(GLuint tex)
+{
+    if (!tex)
+        return;
+    auto k = keyByTex.find(tex);
+    if (k == keyByTex.end())
+    {
+        std::cerr << "TextureCache: release of unknown texture " << tex << std::endl;
+        return;
+    }
+    auto it = entries.find(k->second);
+    if (it->second.refs > 0)
+        --it->second.refs;
+    GpuResources::Touch(GpuKind::Texture, tex);
+}
+
+void TextureCache::Trim()
+{
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        auto next = std::next(it);
+        if (it->second.tex == 0)
+            entries.erase(it);
+        else if (it->second.refs == 0)
+            FreeEntry(it);
+        it = next;
+    }
+}
+
+TextureCache::Stats TextureCache::GetStats()
+{
+    Stats s = stats;
+    s.textures = keyByTex.size();
+    return s;
+}
@@ -0,0 +1,91 @@
+#include "ecs/VoxelAO.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // occlusion by number of blocking neighbours (0-3)
+    const float levels[4] = {1.0f, 0.8f, 0.6f, 0.4f};
+
+    // p in world units; the ground fills everything below zero
+    bool Solid(const LightmapScene &grid, const glm::vec3 &p)
+    {
+        if (p.y < 0.0f)
+            return true;
+        if (p.y >= grid.wallHeight)
+            return false;
+        int col = static_cast<int>(std::floor((p.x - grid.origin.x) / grid.tileSize));
+        int row = static_cast<int>(std::floor((p.z - grid.origin.y) / grid.tileSize));
+        if (col < 0 || col >= grid.cols)
+            return false;
+        if (grid.wrapRows)
+            row = ((row % grid.rows) + grid.rows) % grid.rows;
+        else if (row < 0 || row >= grid.rows)
+            return false;
+        return grid.solid[static_cast<size_t>(row) * grid.cols + col] != 0;
+    }
+
+    // the two axes spanning a face with an axis-aligned normal
+    void Tangents(const glm::vec3 &n, glm::vec3 &t1, glm::vec3 &t2)
+    {
+        if (std::abs(n.x) > 0.5f)
+        {
+            t1 = glm::vec3(0, 1, 0);
+            t2 = glm::vec3(0, 0, 1);
+        }
+        else if (std::abs(n.y) > 0.5f)
+        {
+            t1 = glm::vec3(1, 0, 0);
+            t2 = glm::vec3(0, 0, 1);
+        }
+        else
+        {
+            t1 = glm::vec3(1, 0, 0);
+            t2 = glm::vec3(0, 1, 0);
+        }
+    }
+}
+
+namespace VoxelAO
+{
+    float Corner(const LightmapScene &grid, const glm::vec3 &p, const glm::vec3 &normal, const glm::vec3 &faceCenter)
+    {
+        if (grid.solid.empty())
+            return 1.0f;
+        glm::vec3 t1, t2;
+        Tangents(normal, t1, t2);
+        // half a cell along each axis; walls are tiles wide and deep, and
+        // the vertical neighbour layers are tiles tall as well
+        float h = grid.tileSize * 0.5f;
+        float a = glm::dot(faceCenter - p, t1) < 0.0f ? -h : h;
+        float b = glm::dot(faceCenter - p, t2) < 0.0f ? -h : h;
+
+        // cells in front of the face that share the corner, besides the
+        // face's own (open) one: beside it along t1, along t2, and diagonally
+        glm::vec3 front = p + normal * h;
+        bool side1 = Solid(grid, front - t1 * a + t2 * b);
+        bool side2 = Solid(grid, front + t1 * a - t2 * b);
+        bool corner = Solid(grid, front - t1 * a - t2 * b);
+        // two sides already close the corner off
+        if (side1 && side2)
+            return levels[3];
+        return levels[side1 + side2 + corner];
+    }
+
+    float Ground(const LightmapScene &grid, const glm::vec3 &p, const glm::vec3 &tileCenter)
+    {
+        if (grid.solid.empty())
+            return 1.0f;
+        float ts = grid.tileSize;
+        float x0 = tileCenter.x - ts * 0.5f, z0 = tileCenter.z - ts * 0.5f;
+        float u = std::clamp((p.x - x0) / ts, 0.0f, 1.0f);
+        float v = std::clamp((p.z - z0) / ts, 0.0f, 1.0f);
+        glm::vec3 center(tileCenter.x, 0.0f, tileCenter.z);
+        glm::vec3 up(0.0f, 1.0f, 0.0f);
+        float c00 = Corner(grid, glm::vec3(x0, 0.0f, z0), up, center);
+        float c10 = Corner(grid, glm::vec3(x0 + ts, 0.0f, z0), up, center);
+        float c01 = Corner(grid, glm::vec3(x0, 0.0f, z0 + ts), up, center);
+        float c11 = Corner(grid, glm::vec3(x0 + ts, 0.0f, z0 + ts), up, center);
+        return (c00 * (1.0f - u) + c10 * u) * (1.0f - v) + (c01 * (1.0f - u) + c11 * u) * v;
+    }
+}
@@ -2,564 +2,21 @@
 #include "ecs/Registry.hpp"
 #include "ecs/Transform.hpp"
 #include "ecs/Mesh.hpp"
-#include "ecs/Texture.hpp"
+#include "ecs/MeshLibrary.hpp"
+#include "ecs/MeshBatch.hpp"
+#include "ecs/VoxelAO.hpp"
+#include "ecs/WorldSegment.hpp"
 #include "ecs/Collider.hpp"
 #include "ecs/Camera.hpp"
+#include "ecs/Light.hpp"
 #include <fstream>
 #include <vector>
 #include <iostream>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <algorithm>
 #include <cmath>
 
-namespace
-{
-    // create plane mesh matching tile grid width/depth
-    Mesh CreatePlaneMesh(float width, float depth, float repeatX = 1.0f, float repeatZ = 1.0f)
-    {
-        float hw = width * 0.5f;
-        float hd = depth * 0.5f;
-        float u0 = 0.0f;
-        float v0 = 0.0f;
-        float u1 = repeatX;
-        float v1 = repeatZ;
-        float vertices[] = {
-            -hw,
-            0.0f,
-            -hd,
-            0.0f,
-            1.0f,
-            0.0f,
-            u0,
-            v0,
-            hw,
-            0.0f,
-            -hd,
-            0.0f,
-            1.0f,
-            0.0f,
-            u1,
-            v0,
-            hw,
-            0.0f,
-            hd,
-            0.0f,
-            1.0f,
-            0.0f,
-            u1,
-            v1,
-            -hw,
-            0.0f,
-            hd,
-            0.0f,
-            1.0f,
-            0.0f,
-            u0,
-            v1,
-        };
-        unsigned int indices[] = {0, 1, 2, 2, 3, 0};
-
-        Mesh mesh;
-        glGenVertexArrays(1, &mesh.vao);
-        glGenBuffers(1, &mesh.vbo);
-        glGenBuffers(1, &mesh.ebo);
-
-        glBindVertexArray(mesh.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glBindVertexArray(0);
-
-        mesh.indexCount = static_cast<int>(sizeof(indices) / sizeof(unsigned int));
-        mesh.texture = 0;
-        mesh.color = glm::vec3(0.15f, 0.8f, 0.25f);
-        return mesh;
-    }
-
-    Mesh CreateCubeMesh()
-    {
-        float vertices[] = {
-            // front
-            -0.5f,
-            -0.5f,
-            0.5f,
-            0,
-            0,
-            1,
-            0,
-            0,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0,
-            0,
-            1,
-            1,
-            0,
-            0.5f,
-            0.5f,
-            0.5f,
-            0,
-            0,
-            1,
-            1,
-            1,
-            -0.5f,
-            0.5f,
-            0.5f,
-            0,
-            0,
-            1,
-            0,
-            1,
-            // back
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            0,
-            0,
-            -1,
-            1,
-            0,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0,
-            0,
-            -1,
-            0,
-            0,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0,
-            0,
-            -1,
-            0,
-            1,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            0,
-            0,
-            -1,
-            1,
-            1,
-            // left
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            -1,
-            0,
-            0,
-            0,
-            0,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -1,
-            0,
-            0,
-            1,
-            0,
-            -0.5f,
-            0.5f,
-            0.5f,
-            -1,
-            0,
-            0,
-            1,
-            1,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            -1,
-            0,
-            0,
-            0,
-            1,
-            // right
-            0.5f,
-            -0.5f,
-            -0.5f,
-            1,
-            0,
-            0,
-            1,
-            0,
-            0.5f,
-            -0.5f,
-            0.5f,
-            1,
-            0,
-            0,
-            0,
-            0,
-            0.5f,
-            0.5f,
-            0.5f,
-            1,
-            0,
-            0,
-            0,
-            1,
-            0.5f,
-            0.5f,
-            -0.5f,
-            1,
-            0,
-            0,
-            1,
-            1,
-            // top
-            -0.5f,
-            0.5f,
-            0.5f,
-            0,
-            1,
-            0,
-            0,
-            0,
-            0.5f,
-            0.5f,
-            0.5f,
-            0,
-            1,
-            0,
-            1,
-            0,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0,
-            1,
-            0,
-            1,
-            1,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            0,
-            1,
-            0,
-            0,
-            1,
-            // bottom
-            -0.5f,
-            -0.5f,
-            0.5f,
-            0,
-            -1,
-            0,
-            0,
-            1,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0,
-            -1,
-            0,
-            1,
-            1,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0,
-            -1,
-            0,
-            1,
-            0,
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            0,
-            -1,
-            0,
-            0,
-            0,
-        };
-        unsigned int indices[] = {
-            0, 1, 2, 2, 3, 0,
-            4, 5, 6, 6, 7, 4,
-            8, 9, 10, 10, 11, 8,
-            12, 13, 14, 14, 15, 12,
-            16, 17, 18, 18, 19, 16,
-            20, 21, 22, 22, 23, 20};
-
-        Mesh mesh;
-        glGenVertexArrays(1, &mesh.vao);
-        glGenBuffers(1, &mesh.vbo);
-        glGenBuffers(1, &mesh.ebo);
-
-        glBindVertexArray(mesh.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glBindVertexArray(0);
-
-        mesh.indexCount = static_cast<int>(sizeof(indices) / sizeof(unsigned int));
-        mesh.texture = 0;
-        mesh.color = glm::vec3(0.6f, 0.4f, 0.2f);
-        return mesh;
-    }
-
-    Mesh CreateWallMesh(float width, float height, float depth)
-    {
-        float hw = width * 0.5f;
-        float hh = height * 0.5f;
-        float hd = depth * 0.5f;
-        float vertices[] = {
-            -hw,
-            -hh,
-            -hd,
-            0,
-            0,
-            1,
-            0,
-            0,
-            hw,
-            -hh,
-            -hd,
-            0,
-            0,
-            1,
-            1,
-            0,
-            hw,
-            hh,
-            -hd,
-            0,
-            0,
-            1,
-            1,
-            1,
-            -hw,
-            hh,
-            -hd,
-            0,
-            0,
-            1,
-            0,
-            1,
-        };
-        unsigned int indices[] = {0, 1, 2, 2, 3, 0};
-        Mesh mesh;
-        glGenVertexArrays(1, &mesh.vao);
-        glGenBuffers(1, &mesh.vbo);
-        glGenBuffers(1, &mesh.ebo);
-        glBindVertexArray(mesh.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glBindVertexArray(0);
-        mesh.indexCount = static_cast<int>(sizeof(indices) / sizeof(unsigned int));
-        mesh.texture = 0;
-        mesh.color = glm::vec3(0.3f, 0.3f, 0.8f);
-        return mesh;
-    }
-
-    // create a sin-wave mesh spanning tileSize in X and depth in Z
-    Mesh CreateWaveMesh(float tileSize, int segments = 24)
-    {
-        int seg = std::max(4, segments);
-        float hw = tileSize * 0.5f;         // full tile width
-        float hd = tileSize * 0.15f;        // thickness in Z (half depth)
-        float amp = tileSize * 0.225f;      // amplitude (half of previous)
-        float extraLift = tileSize * 0.35f; // raise crest above previous placement
-        float lift = amp + extraLift;       // small lift so wave doesn't touch base exactly
-        float baseY = 0.0f;                 // floor relative to mesh local origin
-        int waves = 1;                      // number of wave cycles across the tile
-
-        std::vector<float> verts;
-        std::vector<unsigned int> inds;
-
-        auto pushV = [&](float x, float y, float z, float nx, float ny, float nz, float u, float v)
-        {
-            verts.push_back(x);
-            verts.push_back(y);
-            verts.push_back(z);
-            verts.push_back(nx);
-            verts.push_back(ny);
-            verts.push_back(nz);
-            verts.push_back(u);
-            verts.push_back(v);
-        };
-
-        // top strip (triangle strip style): back/top then front/top for each sample
-        const float x0 = -hw;
-        const float x1 = hw;
-        for (int i = 0; i <= seg; ++i)
-        {
-            float t = static_cast<float>(i) / static_cast<float>(seg);
-            float x = x0 + t * (x1 - x0);
-            float y = lift + amp * sinf(2.0f * 3.14159265f * waves * t);
-            // back-top (z = -hd)
-            pushV(x, y, -hd, 0.0f, 1.0f, 0.0f, t, 0.0f);
-            // front-top (z = +hd)
-            pushV(x, y, hd, 0.0f, 1.0f, 0.0f, t, 1.0f);
-        }
-        unsigned int topCount = static_cast<unsigned int>((seg + 1) * 2);
-
-        // front vertical strip (connect top to baseY at +hd)
-        unsigned int frontStart = static_cast<unsigned int>(verts.size() / 8);
-        for (int i = 0; i <= seg; ++i)
-        {
-            float t = static_cast<float>(i) / static_cast<float>(seg);
-            float x = x0 + t * (x1 - x0);
-            float y = lift + amp * sinf(2.0f * 3.14159265f * waves * t);
-            // top (front)
-            pushV(x, y, hd, 0.0f, 0.0f, 1.0f, t, 0.0f);
-            // bottom (front)
-            pushV(x, baseY, hd, 0.0f, 0.0f, 1.0f, t, 1.0f);
-        }
-        unsigned int frontCount = static_cast<unsigned int>((seg + 1) * 2);
-
-        // back vertical strip (connect top to baseY at -hd)
-        unsigned int backStart = static_cast<unsigned int>(verts.size() / 8);
-        for (int i = 0; i <= seg; ++i)
-        {
-            float t = static_cast<float>(i) / static_cast<float>(seg);
-            float x = x0 + t * (x1 - x0);
-            float y = lift + amp * sinf(2.0f * 3.14159265f * waves * t);
-            // top (back)
-            pushV(x, y, -hd, 0.0f, 0.0f, -1.0f, t, 0.0f);
-            // bottom (back)
-            pushV(x, baseY, -hd, 0.0f, 0.0f, -1.0f, t, 1.0f);
-        }
-        unsigned int backCount = static_cast<unsigned int>((seg + 1) * 2);
-
-        // bottom rectangle
-        unsigned int bottomStart = static_cast<unsigned int>(verts.size() / 8);
-        pushV(x0, baseY, hd, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f);
-        pushV(x1, baseY, hd, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f);
-        pushV(x1, baseY, -hd, 0.0f, -1.0f, 0.0f, 1.0f, 1.0f);
-        pushV(x0, baseY, -hd, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f);
-
-        // top surface (triangle strip style): two verts per sample => quads between pairs
-        for (unsigned int i = 0; i < static_cast<unsigned int>(seg); ++i)
-        {
-            unsigned int a = i * 2;
-            unsigned int b = a + 1;
-            unsigned int c = a + 2;
-            unsigned int d = a + 3;
-            inds.push_back(a);
-            inds.push_back(b);
-            inds.push_back(c);
-            inds.push_back(c);
-            inds.push_back(b);
-            inds.push_back(d);
-        }
-
-        // front vertical strip
-        unsigned int fBase = frontStart;
-        for (unsigned int i = 0; i < static_cast<unsigned int>(seg); ++i)
-        {
-            unsigned int a = fBase + i * 2;
-            unsigned int b = a + 1;
-            unsigned int c = a + 2;
-            unsigned int d = a + 3;
-            inds.push_back(a);
-            inds.push_back(c);
-            inds.push_back(b);
-            inds.push_back(c);
-            inds.push_back(d);
-            inds.push_back(b);
-        }
-
-        // back vertical strip
-        unsigned int bkBase = backStart;
-        for (unsigned int i = 0; i < static_cast<unsigned int>(seg); ++i)
-        {
-            unsigned int a = bkBase + i * 2;
-            unsigned int b = a + 1;
-            unsigned int c = a + 2;
-            unsigned int d = a + 3;
-            inds.push_back(a);
-            inds.push_back(b);
-            inds.push_back(c);
-            inds.push_back(c);
-            inds.push_back(b);
-            inds.push_back(d);
-        }
-
-        // bottom face (single quad)
-        inds.push_back(bottomStart + 0);
-        inds.push_back(bottomStart + 1);
-        inds.push_back(bottomStart + 2);
-        inds.push_back(bottomStart + 2);
-        inds.push_back(bottomStart + 3);
-        inds.push_back(bottomStart + 0);
-
-        // left cap (x0)
-        unsigned int leftTopBack = 0;
-        unsigned int leftTopFront = 1;
-        unsigned int leftFrontBottom = frontStart + 1;
-        unsigned int leftBackBottom = backStart + 1;
-        inds.push_back(leftTopBack);
-        inds.push_back(leftBackBottom);
-        inds.push_back(leftTopFront);
-        inds.push_back(leftTopFront);
-        inds.push_back(leftBackBottom);
-        inds.push_back(leftFrontBottom);
-
-        // right cap (x1)
-        unsigned int rightTopBack = (seg) * 2;
-        unsigned int rightTopFront = rightTopBack + 1;
-        unsigned int rightFrontBottom = frontStart + seg * 2 + 1;
-        unsigned int rightBackBottom = backStart + seg * 2 + 1;
-        inds.push_back(rightTopBack);
-        inds.push_back(rightTopFront);
-        inds.push_back(rightBackBottom);
-        inds.push_back(rightBackBottom);
-        inds.push_back(rightTopFront);
-        inds.push_back(rightFrontBottom);
-
-        Mesh mesh;
-        glGenVertexArrays(1, &mesh.vao);
-        glGenBuffers(1, &mesh.vbo);
-        glGenBuffers(1, &mesh.ebo);
-        glBindVertexArray(mesh.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-        glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, inds.size() * sizeof(unsigned int), inds.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glBindVertexArray(0);
-        mesh.indexCount = static_cast<int>(inds.size());
-        mesh.texture = 0;
-        mesh.color = glm::vec3(0.2f, 0.5f, 0.95f);
-        return mesh;
-    }
-}
-
 WorldRepeater::WorldRepeater() {}
 WorldRepeater::~WorldRepeater() { Cleanup(); }
 
@@ -573,9 +30,102 @@ void WorldRepeater::Configure(const std::string &mapPath, int repeats, float spd
 
 void WorldRepeater::Cleanup()
 {
+    MeshLibrary::Free(segmentMesh);
+    segmentMesh = Mesh();
+    materials.Free();
+    lightmap.Clear();
+    pvs.Clear();
+    wallCharts.clear();
+    groundChart = -1;
     initialized = false;
 }
 
+namespace
+{
+    // cube faces by axis and sign, with two axes spanning each face
+    struct Face
+    {
+        glm::vec3 normal, u, v;
+    };
+    const Face cubeFaces[6] = {
+        {{1, 0, 0}, {0, 0, -1}, {0, 1, 0}},
+        {{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+        {{0, 1, 0}, {1, 0, 0}, {0, 0, -1}},
+        {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+        {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},
+        {{0, 0, -1}, {-1, 0, 0}, {0, 1, 0}},
+    };
+
+    // index into cubeFaces of an axis-aligned normal
+    int FaceOf(const glm::vec3 &n)
+    {
+        glm::vec3 a(std::abs(n.x), std::abs(n.y), std::abs(n.z));
+        int axis = a.x >= a.y && a.x >= a.z ? 0 : (a.y >= a.z ? 1 : 2);
+        return axis * 2 + (n[axis] < 0.0f ? 1 : 0);
+    }
+}
+
+void WorldRepeater::BakeLighting(Registry &registry, const std::vector<std::string> &lines, size_t rows, size_t cols)
+{
+    lightmap.Clear();
+    wallCharts.clear();
+
+    LightmapSettings settings;
+    grid = LightmapScene();
+    grid.rows = static_cast<int>(rows);
+    grid.cols = static_cast<int>(cols);
+    grid.tileSize = tileSize;
+    grid.wallHeight = tileSize * 2.0f;
+    grid.origin = glm::vec2(-mapWidth * 0.5f, -mapDepth * 0.5f);
+    grid.wrapRows = segmentRepeats > 1;
+    grid.solid.assign(rows * cols, 0);
+
+    groundChart = lightmap.AddChart(glm::vec3(-mapWidth * 0.5f, 0.0f, mapDepth * 0.5f), glm::vec3(mapWidth, 0.0f, 0.0f),
+                                    glm::vec3(0.0f, 0.0f, -mapDepth), glm::vec3(0.0f, 1.0f, 0.0f), settings.texelsPerUnit);
+    glm::vec3 extent(tileSize * 0.5f, tileSize, tileSize * 0.5f);
+    for (size_t r = 0; r < rows; ++r)
+    {
+        for (size_t c = 0; c < cols; ++c)
+        {
+            if (c >= lines[r].size() || lines[r][c] != '1')
+                continue;
+            grid.solid[r * cols + c] = 1;
+            glm::vec3 center(grid.origin.x + (c + 0.5f) * tileSize, tileSize, grid.origin.y + (r + 0.5f) * tileSize);
+            for (const Face &f : cubeFaces)
+            {
+                glm::vec3 halfU = f.u * glm::dot(glm::abs(f.u), extent);
+                glm::vec3 halfV = f.v * glm::dot(glm::abs(f.v), extent);
+                glm::vec3 origin = center + f.normal * glm::dot(glm::abs(f.normal), extent) - halfU - halfV;
+                wallCharts.push_back(lightmap.AddChart(origin, halfU * 2.0f, halfV * 2.0f, f.normal, settings.texelsPerUnit));
+            }
+        }
+    }
+    lightmap.Pack();
+
+    SunFromMainLight(registry, settings);
+    lightSettings = settings;
+    if (lightmap.Bake(grid, settings))
+        lightmap.Upload();
+}
+
+void WorldRepeater::SunFromMainLight(Registry &registry, LightmapSettings &settings)
+{
+    // the main light is baked as a sun from its direction, with the falloff
+    // fragment.glsl gives it at the map's center
+    for (auto [e, light] : registry.View<Light>())
+    {
+        auto transform = registry.GetComponent<Transform>(e);
+        if (!transform || light->radius > 0.0f)
+            continue;
+        float distance = glm::length(transform->position);
+        if (distance > 0.0f)
+            settings.sunDirection = transform->position / distance;
+        float attenuation = 1.0f / (1.0f + 0.07f * distance + 0.017f * distance * distance);
+        settings.sunColor = light->color * light->intensity * attenuation;
+        break;
+    }
+}
+
 void WorldRepeater::Update(Registry &registry, float dt)
 {
     if (!initialized)
@@ -609,32 +159,101 @@ void WorldRepeater::Update(Registry &registry, float dt)
         this->mapWidth = mapWidth;
         this->mapDepth = mapDepth;
 
-        Mesh groundMesh = CreatePlaneMesh(mapWidth, mapDepth, static_cast<float>(cols), static_cast<float>(rows));
-        groundMesh.texture = Texture::Load("data/grass.jpg");
-
-        Mesh cubeMesh = CreateCubeMesh();
-        GLuint wood = Texture::Load("data/wood.jpg");
-        if (wood)
-            cubeMesh.texture = wood;
-
-        // a flat blue tile
-        Mesh blueMesh = CreatePlaneMesh(tileSize, tileSize, 1.0f, 1.0f);
-        blueMesh.texture = 0;
-        blueMesh.color = glm::vec3(0.2f, 0.2f, 0.9f);
-
-        Mesh waterBaseMesh = CreatePlaneMesh(tileSize, tileSize, 1.0f, 1.0f);
-
-        GLuint grassTex = Texture::Load("data/grass.jpg");
-        if (grassTex)
-            waterBaseMesh.texture = grassTex;
-        else
-            waterBaseMesh.color = glm::vec3(0.15f, 0.8f, 0.25f);
-        Mesh waveMesh = CreateWaveMesh(tileSize, 28);
-        GLuint waterTex = Texture::Load("data/water.jpg");
-        if (waterTex)
-            waveMesh.texture = waterTex;
-        else
-            waveMesh.color = glm::vec3(0.2f, 0.5f, 0.95f);
+        // every tile material shares one texture array, and every segment is
+        // the same map, so the whole world is one batched mesh drawn once per segment
+        materials.Clear();
+        int grassLayer = materials.AddLayer("data/grass.jpg", glm::vec3(0.15f, 0.8f, 0.25f));
+        int woodLayer = materials.AddLayer("data/wood.jpg", glm::vec3(0.6f, 0.4f, 0.2f));
+        int waterLayer = materials.AddLayer("data/water.jpg", glm::vec3(0.2f, 0.5f, 0.95f));
+        materials.Build();
+
+        float offsetX = (static_cast<float>(cols - 1) * tileSize) * 0.5f;
+        float offsetZ = (static_cast<float>(rows - 1) * tileSize) * 0.5f;
+
+        BakeLighting(registry, lines, rows, cols);
+        pvs.Bake(grid, PvsSettings());
+
+        // segment-local geometry; the segment entity's transform scrolls it.
+        // the ground is one quad per open tile, so its corners can take
+        // their own occlusion from the walls around them
+        MeshBatch batch;
+        MeshData cube = MeshLibrary::CubeData();
+        MeshData groundTile = MeshLibrary::PlaneData(tileSize, tileSize, 1.0f, 1.0f);
+        glm::vec3 wallExtent(tileSize * 0.5f, tileSize, tileSize * 0.5f);
+        MeshData wave = MeshLibrary::WaveData(tileSize, 28);
+        std::vector<glm::vec3> wallCenters;
+        for (size_t r = 0; r < rows; ++r)
+        {
+            for (size_t c = 0; c < cols; ++c)
+            {
+                char ch = c < lines[r].size() ? lines[r][c] : '0';
+                float x = static_cast<float>(c) * tileSize - offsetX;
+                float z = static_cast<float>(r) * tileSize - offsetZ;
+                if (ch == '1')
+                {
+                    glm::vec3 center(x, tileSize * 1.0f, z);
+                    glm::mat4 m = glm::translate(glm::mat4(1.0f), center);
+                    m = glm::scale(m, glm::vec3(tileSize, tileSize * 2.0f, tileSize));
+                    const int *faces = wallCharts.data() + wallCenters.size() * 6;
+                    batch.Add(cube, m, woodLayer, [this, faces, center, wallExtent](const glm::vec3 &p, const glm::vec3 &n)
+                              {
+                                  glm::vec3 faceCenter = center + n * glm::dot(glm::abs(n), wallExtent);
+                                  return MeshBatch::Extras{lightmap.AtlasUV(faces[FaceOf(n)], p), VoxelAO::Corner(grid, p, n, faceCenter)}; });
+                    wallCenters.push_back(center);
+                    continue;
+                }
+
+                // water sits on the ground, so it shares the ground's chart and corners
+                glm::vec3 tileCenter(x, 0.0f, z);
+                MeshBatch::ExtrasFn ground = [this, tileCenter](const glm::vec3 &p, const glm::vec3 &)
+                { return MeshBatch::Extras{lightmap.AtlasUV(groundChart, p), VoxelAO::Ground(grid, p, tileCenter)}; };
+                batch.Add(groundTile, glm::translate(glm::mat4(1.0f), tileCenter), grassLayer, ground);
+                // the wave band sits slightly above the ground to avoid z-fighting
+                if (ch == '2')
+                    batch.Add(wave, glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.02f, z)), waterLayer, ground);
+            }
+        }
+        // walls merge into rectangles of tiles, one occluder box each: grow
+        // along the row from the first unclaimed wall, then down while every
+        // row below is wall across the same columns
+        std::vector<WorldSegment::Box> occluders;
+        std::vector<uint8_t> claimed(rows * cols, 0);
+        auto isWall = [&](size_t r, size_t c)
+        { return c < lines[r].size() && lines[r][c] == '1' && !claimed[r * cols + c]; };
+        for (size_t r = 0; r < rows; ++r)
+        {
+            for (size_t c = 0; c < cols; ++c)
+            {
+                if (!isWall(r, c))
+                    continue;
+                size_t endCol = c;
+                while (endCol < cols && isWall(r, endCol))
+                    ++endCol;
+                size_t endRow = r + 1;
+                for (; endRow < rows; ++endRow)
+                {
+                    size_t k = c;
+                    while (k < endCol && isWall(endRow, k))
+                        ++k;
+                    if (k < endCol)
+                        break;
+                }
+                for (size_t rr = r; rr < endRow; ++rr)
+                    std::fill(claimed.begin() + rr * cols + c, claimed.begin() + rr * cols + endCol, 1);
+
+                WorldSegment::Box box;
+                box.min = glm::vec3(static_cast<float>(c) * tileSize - offsetX - tileSize * 0.5f, 0.0f,
+                                    static_cast<float>(r) * tileSize - offsetZ - tileSize * 0.5f);
+                box.max = glm::vec3(static_cast<float>(endCol - 1) * tileSize - offsetX + tileSize * 0.5f, tileSize * 2.0f,
+                                    static_cast<float>(endRow - 1) * tileSize - offsetZ + tileSize * 0.5f);
+                occluders.push_back(box);
+                c = endCol - 1;
+            }
+        }
+
+        segmentMesh = batch.Upload("world segment");
+        segmentMesh.textureArray = materials.Id();
+        segmentMesh.lightmap = lightmap.Id();
 
         // create repeated segments along +Z
         copies.clear();
@@ -647,13 +266,20 @@ void WorldRepeater::Update(Registry &registry, float dt)
             std::vector<Entity> created;
             std::vector<glm::vec3> initialPos;
 
-            // create ground entity
+            // segment entity: the batched mesh plus the ground collider
             Entity g = registry.CreateEntity();
             Transform gt;
             gt.position = glm::vec3(0.0f, 0.0f, baseZ);
             gt.scale = glm::vec3(1.0f, 1.0f, 1.0f);
             registry.AddComponent<Transform>(g, gt);
-            registry.AddComponent<Mesh>(g, groundMesh);
+            registry.AddComponent<Mesh>(g, segmentMesh);
+            WorldSegment segment;
+            segment.boundsMin = glm::vec3(-mapWidth * 0.5f, 0.0f, -mapDepth * 0.5f);
+            segment.boundsMax = glm::vec3(mapWidth * 0.5f, tileSize * 2.0f, mapDepth * 0.5f);
+            segment.period = mapDepth;
+            segment.occluders = occluders;
+            segment.pvs = &pvs;
+            registry.AddComponent<WorldSegment>(g, segment);
             Collider groundCol;
             groundCol.type = Collider::AABB;
             groundCol.halfExtents = glm::vec3(mapWidth * 0.5f, 0.1f, mapDepth * 0.5f);
@@ -661,61 +287,20 @@ void WorldRepeater::Update(Registry &registry, float dt)
             created.push_back(g);
             initialPos.push_back(gt.position);
 
-            float offsetX = (static_cast<float>(cols - 1) * tileSize) * 0.5f;
-            float offsetZ = (static_cast<float>(rows - 1) * tileSize) * 0.5f;
-            for (size_t r = 0; r < rows; ++r)
+            // walls keep their own colliders but have nothing to draw
+            for (const glm::vec3 &center : wallCenters)
             {
-                for (size_t c = 0; c < cols; ++c)
-                {
-                    char ch = '0';
-                    if (c < lines[r].size())
-                        ch = lines[r][c];
-
-                    if (ch == '1' || ch == '2')
-                    {
-                        float x = static_cast<float>(c) * tileSize - offsetX;
-                        float z = static_cast<float>(r) * tileSize - offsetZ + baseZ;
-
-                        if (ch == '1')
-                        {
-                            Entity e = registry.CreateEntity();
-                            Transform t;
-                            t.position = glm::vec3(x, tileSize * 1.0f, z);
-                            t.scale = glm::vec3(tileSize, tileSize * 2.0f, tileSize);
-                            registry.AddComponent<Transform>(e, t);
-                            registry.AddComponent<Mesh>(e, cubeMesh);
-                            Collider ccol;
-                            ccol.type = Collider::AABB;
-                            ccol.halfExtents = glm::vec3(tileSize * 0.5f, tileSize * 1.0f, tileSize * 0.5f);
-                            registry.AddComponent<Collider>(e, ccol);
-                            created.push_back(e);
-                            initialPos.push_back(t.position);
-                        }
-                        else
-                        {
-                            Entity baseE = registry.CreateEntity();
-                            Transform bt;
-                            bt.position = glm::vec3(x, 0.01f, z);
-                            bt.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-                            registry.AddComponent<Transform>(baseE, bt);
-                            registry.AddComponent<Mesh>(baseE, waterBaseMesh);
-                            created.push_back(baseE);
-                            initialPos.push_back(bt.position);
-
-                            // wave band on top (filled down to floor). place slightly above base to avoid z-fighting
-                            Entity waveE = registry.CreateEntity();
-                            Transform vt;
-                            // place wave so its bottom sits near the floor to fill downwards
-                            float waveYOffset = 0.02f;
-                            vt.position = glm::vec3(x, waveYOffset, z);
-                            vt.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-                            registry.AddComponent<Transform>(waveE, vt);
-                            registry.AddComponent<Mesh>(waveE, waveMesh);
-                            created.push_back(waveE);
-                            initialPos.push_back(vt.position);
-                        }
-                    }
-                }
+                Entity e = registry.CreateEntity();
+                Transform t;
+                t.position = center + glm::vec3(0.0f, 0.0f, baseZ);
+                t.scale = glm::vec3(tileSize, tileSize * 2.0f, tileSize);
+                registry.AddComponent<Transform>(e, t);
+                Collider ccol;
+                ccol.type = Collider::AABB;
+                ccol.halfExtents = glm::vec3(tileSize * 0.5f, tileSize * 1.0f, tileSize * 0.5f);
+                registry.AddComponent<Collider>(e, ccol);
+                created.push_back(e);
+                initialPos.push_back(t.position);
             }
 
             copies.push_back(std::move(created));
@@ -726,6 +311,16 @@ void WorldRepeater::Update(Registry &registry, float dt)
         std::cerr << "WorldRepeater: initialized repeats=" << segmentRepeats << " mapDepth=" << mapDepth << std::endl;
     }
 
+    // edits to the main light (LightSystem's window) rebake in the background;
+    // the cache key covers the sun, so settings seen before load instantly
+    LightmapSettings sun = lightSettings;
+    SunFromMainLight(registry, sun);
+    if ((sun.sunDirection != lightSettings.sunDirection || sun.sunColor != lightSettings.sunColor) && !lightmap.Rebaking())
+    {
+        lightSettings = sun;
+        lightmap.Rebake(grid, lightSettings);
+    }
+
     // deterministic scrolling
     totalScroll -= static_cast<double>(speed) * static_cast<double>(dt);
     if (mapDepth <= 0.0f)
@@ -3,10 +3,13 @@
 #include "ecs/System.hpp"
 #include "ecs/Transform.hpp"
 #include "ecs/Mesh.hpp"
+#include "ecs/MeshLibrary.hpp"
 #include "ecs/RenderSystem.hpp"
 #include "ecs/Camera.hpp"
 #include "ecs/CameraSystem.hpp"
+#include "ecs/Shader.hpp"
 #include "ecs/Texture.hpp"
+#include "ecs/TextureCache.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <imgui.h>
@@ -25,7 +28,13 @@
 #include "ecs/Collider.hpp"
 #include "ecs/Velocity.hpp"
 #include "ecs/SkyboxSystem.hpp"
+#include "ecs/AsyncTextureLoader.hpp"
 #include "ecs/WorldRepeater.hpp"
+#include "renderer/GLState.hpp"
+#include "renderer/GpuResources.hpp"
+#include "renderer/PboUploader.hpp"
+#include "renderer/ProgramCache.hpp"
+#include "renderer/RenderGraph.hpp"
 
 struct Position
 {
@@ -35,9 +44,12 @@ struct Position
 class DemoSystem : public System
 {
     bool *showUI = nullptr;
+    RenderGraph *graph = nullptr;
+    const RenderSystem *renderer = nullptr;
 
 public:
-    DemoSystem(bool *show = nullptr) : showUI(show) {}
+    DemoSystem(bool *show = nullptr, RenderGraph *g = nullptr, const RenderSystem *r = nullptr)
+        : showUI(show), graph(g), renderer(r) {}
 
     void Update(Registry &registry, float dt) override
     {
@@ -75,6 +87,53 @@ public:
         ImGui::BulletText("Mesh: %d", meshCount);
         ImGui::BulletText("Camera: %d", cameraCount);
 
+        ImGui::Separator();
+        ImGui::Text("Shared meshes: %zu (%.1f KB)", MeshLibrary::MeshCount(), MeshLibrary::GpuBytes() / 1024.0f);
+        ImGui::Text("GPU memory: %.1f MB (peak %.1f MB, budget %.0f MB)", GpuResources::TotalBytes() / (1024.0f * 1024.0f),
+                    GpuResources::PeakBytes() / (1024.0f * 1024.0f), GpuResources::GetBudget() / (1024.0f * 1024.0f));
+        ImGui::BulletText("Textures: %zu (%.1f MB)", GpuResources::Count(GpuKind::Texture), GpuResources::Bytes(GpuKind::Texture) / (1024.0f * 1024.0f));
+        TextureCache::Stats texStats = TextureCache::GetStats();
+        ImGui::BulletText("Texture cache: %zu resident, %zu hits / %zu misses (%zu failed)",
+                          texStats.textures, texStats.hits, texStats.misses, texStats.failures);
+        ImGui::BulletText("Buffers: %zu (%.1f KB)", GpuResources::Count(GpuKind::Buffer), GpuResources::Bytes(GpuKind::Buffer) / 1024.0f);
+        ProgramCache::Stats progStats = ProgramCache::GetStats();
+        ImGui::BulletText("Program cache: %s, %zu hits / %zu misses (%zu rejected)", ProgramCache::Available() ? "on" : "off",
+                          progStats.hits, progStats.misses, progStats.rejected);
+        GLState::Stats glStats = GLState::LastFrame();
+        ImGui::BulletText("GL state calls: %zu issued, %zu filtered last frame", glStats.issued, glStats.filtered);
+        if (ImGui::TreeNode("Texture memory"))
+        {
+            GpuResources::ForEach(GpuKind::Texture, [](GLuint id, const std::string &label, size_t bytes)
+                                  { ImGui::Text("#%u %8.1f KB  %s", id, bytes / 1024.0f, label.c_str()); });
+            ImGui::TreePop();
+        }
+        if (graph && ImGui::TreeNode("Render passes"))
+        {
+            ImGui::Text("%zu transient targets in %zu textures", graph->TransientCount(), graph->PhysicalCount());
+            for (const RenderGraph::PassStats &pass : graph->Stats())
+            {
+                bool enabled = graph->IsEnabled(pass.name);
+                if (ImGui::Checkbox(pass.name.c_str(), &enabled))
+                    graph->SetEnabled(pass.name, enabled);
+                ImGui::SameLine();
+                if (!enabled || pass.culled)
+                    ImGui::TextDisabled(enabled ? "culled" : "off");
+                else
+                    ImGui::Text("cpu %.3f ms  gpu %.3f ms", pass.cpuMs, pass.gpuMs);
+            }
+            ImGui::TreePop();
+        }
+        if (renderer && ImGui::TreeNode("Culling"))
+        {
+            const SoftwareOcclusion::Stats &cpu = renderer->Occlusion().GetStats();
+            ImGui::Text("CPU occlusion: %zu occluders, %zu / %zu culled", cpu.occluders, cpu.culled, cpu.tested);
+            ImGui::Text("PVS: %zu culled", renderer->PvsCulled());
+            const OcclusionQueries::Stats &gpu = renderer->Queries().GetStats();
+            ImGui::Text("GPU queries: %zu issued, %zu conditional draws, %zu pooled", gpu.tracked, gpu.conditional, gpu.created);
+            ImGui::Text("GPU results: %zu visible, %zu occluded", gpu.visible, gpu.occluded);
+            ImGui::TreePop();
+        }
+
         ImGui::Separator();
         ImGui::Text("Runtime state:");
         ImGui::Text("Menu visible: %s", (*showUI) ? "Yes" : "No");
@@ -98,82 +157,36 @@ public:
     }
 };
 
-Mesh CreateColoredCube(float size = 0.2f)
-{
-    float s = size * 0.5f;
-    // same layout: pos, normal, uv (uv unused)
-    float vertices[] = {
-        // front
-        -s, -s, s, 0, 0, 1, 0, 0,
-        s, -s, s, 0, 0, 1, 1, 0,
-        s, s, s, 0, 0, 1, 1, 1,
-        -s, s, s, 0, 0, 1, 0, 1,
-        // back
-        -s, -s, -s, 0, 0, -1, 1, 0,
-        s, -s, -s, 0, 0, -1, 0, 0,
-        s, s, -s, 0, 0, -1, 0, 1,
-        -s, s, -s, 0, 0, -1, 1, 1,
-        // left
-        -s, -s, -s, -1, 0, 0, 0, 0,
-        -s, -s, s, -1, 0, 0, 1, 0,
-        -s, s, s, -1, 0, 0, 1, 1,
-        -s, s, -s, -1, 0, 0, 0, 1,
-        // right
-        s, -s, -s, 1, 0, 0, 1, 0,
-        s, -s, s, 1, 0, 0, 0, 0,
-        s, s, s, 1, 0, 0, 0, 1,
-        s, s, -s, 1, 0, 0, 1, 1,
-        // top
-        -s, s, s, 0, 1, 0, 0, 0,
-        s, s, s, 0, 1, 0, 1, 0,
-        s, s, -s, 0, 1, 0, 1, 1,
-        -s, s, -s, 0, 1, 0, 0, 1,
-        // bottom
-        -s, -s, s, 0, -1, 0, 0, 1,
-        s, -s, s, 0, -1, 0, 1, 1,
-        s, -s, -s, 0, -1, 0, 1, 0,
-        -s, -s, -s, 0, -1, 0, 0, 0};
-
-    unsigned int indices[] = {0, 1, 2, 2, 3, 0, 4, 5, 6, 6, 7, 4, 8, 9, 10, 10,
-                              11, 8, 12, 13, 14, 14, 15, 12, 16, 17, 18, 18, 19,
-                              16, 20, 21, 22, 22, 23, 20};
-
-    Mesh mesh;
-    glGenVertexArrays(1, &mesh.vao);
-    glGenBuffers(1, &mesh.vbo);
-    glGenBuffers(1, &mesh.ebo);
-
-    glBindVertexArray(mesh.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glBindVertexArray(0);
-
-    mesh.indexCount = static_cast<int>(sizeof(indices) / sizeof(unsigned int));
-    mesh.texture = 0;
-    return mesh;
-}
-
 int main()
 {
     Window window;
     if (!window.Init("FPS Duck", 1280, 720))
         return -1;
 
+    // linked shader programs are reused across launches when the driver allows;
+    // the rest compile on driver threads while assets load
+    ProgramCache::Init("cache/shaders");
+    Shader::InitParallelCompile();
+
+    // unreferenced cached assets are evicted once GPU usage passes this
+    GpuResources::SetBudget(256ull * 1024 * 1024);
+
+    // world tiles are about a metre wide, so full-resolution photos are wasted
+    // on them; larger images are downscaled (or lose their top mips) on load
+    Texture::SetBudget({1024, 96ull * 1024 * 1024});
+
+    // decode textures off the main thread; they are uploaded a few per frame
+    // through a ring of pixel buffer objects
+    AsyncTextureLoader::Start();
+    PboUploader::Init(4);
+
     Registry registry;
     bool showUI = false;
     bool inputCaptured = true;
 
-    DemoSystem demo(&showUI);
+    RenderGraph graph;
     RenderSystem renderSystem;
+    DemoSystem demo(&showUI, &graph, &renderSystem);
     SkyboxSystem skyboxSystem;
     BulletSystem bulletSystem;
     PlayerSystem playerSystem(&bulletSystem);
@@ -230,13 +243,19 @@ int main()
         if (f)
         {
             fclose(f);
-            if (!skyboxSystem.LoadFromCrossImage(p))
-                std::cerr << "Skybox: failed to load cross image " << p << std::endl;
-            else
-                renderSystem.SetSkybox(&skyboxSystem);
+            skyboxSystem.LoadFromCrossImageAsync(p, "data/skybox.cubemap");
+            renderSystem.SetSkybox(&skyboxSystem);
         }
     }
 
+    // the frame: scene passes into the window's buffers, then ImGui on top
+    RenderGraph::Resource backbuffer = graph.Import("backbuffer");
+    RenderGraph::Resource depthBuffer = graph.Import("depth");
+    graph.MarkOutput(backbuffer);
+    renderSystem.AddPasses(graph, backbuffer, depthBuffer);
+    graph.AddPass({"ui", {}, {backbuffer, depthBuffer}, [&window]
+                   { window.RenderUI(); }});
+
     while (running)
     {
         SDL_Event event;
@@ -286,6 +305,10 @@ int main()
             }
         }
 
+        // upload textures the workers finished decoding, within ~2 ms
+        AsyncTextureLoader::Pump(2.0, 4);
+        PboUploader::Update();
+
         window.BeginFrame();
 
         demo.Update(registry, dt);
@@ -299,10 +322,22 @@ int main()
         fpSystem.Update(registry, dt);
         renderSystem.Update(registry, dt);
 
+        graph.Execute();
         window.EndFrame();
+        GpuResources::EnforceBudget();
     }
 
+    AsyncTextureLoader::Stop();
+    PboUploader::Shutdown();
+    repeater.Cleanup();
+    bulletSystem.Cleanup();
+    skyboxSystem.Cleanup();
     renderSystem.Cleanup();
+    graph.Release();
+    Model::Free(gunMesh);
+    MeshLibrary::Trim();
+    TextureCache::Trim();
+    GpuResources::Report(std::cerr);
     window.Cleanup();
     return 0;
 }
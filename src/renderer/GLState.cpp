@@ -0,0 +1,255 @@
+#include "renderer/GLState.hpp"
+
+namespace
+{
+    // names are GLuint, so ~0 can never be a real binding
+    constexpr GLuint unknownName = ~0u;
+    constexpr GLenum unknownEnum = ~0u;
+    constexpr int unknownFlag = -1;
+
+    constexpr GLuint maxUnits = 16;
+    const GLenum textureTargets[] = {GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER};
+    constexpr size_t targetCount = sizeof(textureTargets) / sizeof(textureTargets[0]);
+
+    const GLenum caps[] = {GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_FRAMEBUFFER_SRGB, GL_SCISSOR_TEST};
+    constexpr size_t capCount = sizeof(caps) / sizeof(caps[0]);
+
+    struct Shadow
+    {
+        GLuint program = unknownName;
+        GLuint vao = unknownName;
+        GLuint framebuffer = unknownName;
+        GLuint activeUnit = unknownName;
+        GLuint textures[maxUnits][targetCount];
+        int capEnabled[capCount];
+        GLenum depthFunc = unknownEnum;
+        int depthMask = unknownFlag;
+        GLenum blendSrc = unknownEnum, blendDst = unknownEnum;
+        GLenum cullFace = unknownEnum;
+        GLenum frontFace = unknownEnum;
+        int unpackAlignment = unknownFlag;
+        bool viewportKnown = false;
+        GLState::Viewport viewport;
+
+        Shadow()
+        {
+            for (auto &unit : textures)
+                for (GLuint &t : unit)
+                    t = unknownName;
+            for (int &c : capEnabled)
+                c = unknownFlag;
+        }
+    };
+
+    Shadow state;
+    GLState::Stats stats;
+    GLState::Stats lastFrame;
+
+    // true when the call has to reach GL
+    template <typename T>
+    bool Changed(T &cached, T value)
+    {
+        if (cached == value)
+        {
+            ++stats.filtered;
+            return false;
+        }
+        cached = value;
+        ++stats.issued;
+        return true;
+    }
+
+    int TargetIndex(GLenum target)
+    {
+        for (size_t i = 0; i < targetCount; ++i)
+        {
+            if (textureTargets[i] == target)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    int CapIndex(GLenum cap)
+    {
+        for (size_t i = 0; i < capCount; ++i)
+        {
+            if (caps[i] == cap)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    void ActivateUnit(GLuint unit)
+    {
+        if (Changed(state.activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+void GLState::UseProgram(GLuint program)
+{
+    if (Changed(state.program, program))
+        glUseProgram(program);
+}
+
+void GLState::BindVertexArray(GLuint vao)
+{
+    if (Changed(state.vao, vao))
+        glBindVertexArray(vao);
+}
+
+void GLState::BindFramebuffer(GLuint framebuffer)
+{
+    if (Changed(state.framebuffer, framebuffer))
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    int t = TargetIndex(target);
+    if (t < 0 || unit >= maxUnits)
+    {
+        ActivateUnit(unit);
+        ++stats.issued;
+        glBindTexture(target, texture);
+        return;
+    }
+    if (state.textures[unit][t] == texture)
+    {
+        ++stats.filtered;
+        return;
+    }
+    ActivateUnit(unit);
+    Changed(state.textures[unit][t], texture);
+    glBindTexture(target, texture);
+}
+
+void GLState::Enable(GLenum cap, bool on)
+{
+    int c = CapIndex(cap);
+    if (c >= 0 && !Changed(state.capEnabled[c], on ? 1 : 0))
+        return;
+    if (c < 0)
+        ++stats.issued;
+    if (on)
+        glEnable(cap);
+    else
+        glDisable(cap);
+}
+
+void GLState::DepthFunc(GLenum func)
+{
+    if (Changed(state.depthFunc, func))
+        glDepthFunc(func);
+}
+
+void GLState::DepthMask(bool write)
+{
+    if (Changed(state.depthMask, write ? 1 : 0))
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::BlendFunc(GLenum src, GLenum dst)
+{
+    if (state.blendSrc == src && state.blendDst == dst)
+    {
+        ++stats.filtered;
+        return;
+    }
+    state.blendSrc = src;
+    state.blendDst = dst;
+    ++stats.issued;
+    glBlendFunc(src, dst);
+}
+
+void GLState::CullFace(GLenum face)
+{
+    if (Changed(state.cullFace, face))
+        glCullFace(face);
+}
+
+void GLState::FrontFace(GLenum mode)
+{
+    if (Changed(state.frontFace, mode))
+        glFrontFace(mode);
+}
+
+void GLState::UnpackAlignment(int alignment)
+{
+    if (Changed(state.unpackAlignment, alignment))
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+void GLState::SetViewport(int x, int y, int width, int height)
+{
+    Viewport &v = state.viewport;
+    if (state.viewportKnown && v.x == x && v.y == y && v.width == width && v.height == height)
+    {
+        ++stats.filtered;
+        return;
+    }
+    state.viewportKnown = true;
+    v = {x, y, width, height};
+    ++stats.issued;
+    glViewport(x, y, width, height);
+}
+
+const GLState::Viewport &GLState::GetViewport()
+{
+    return state.viewport;
+}
+
+void GLState::Invalidate()
+{
+    // the viewport rectangle stays readable; only the filter is dropped
+    Viewport viewport = state.viewport;
+    state = Shadow();
+    state.viewport = viewport;
+}
+
+void GLState::Forget(GpuKind kind, GLuint id)
+{
+    if (!id)
+        return;
+    switch (kind)
+    {
+    case GpuKind::VertexArray:
+        if (state.vao == id)
+            state.vao = 0;
+        break;
+    case GpuKind::Texture:
+        for (auto &unit : state.textures)
+            for (GLuint &t : unit)
+                if (t == id)
+                    t = 0;
+        break;
+    case GpuKind::Framebuffer:
+        // deleting the bound framebuffer reverts to the window's
+        if (state.framebuffer == id)
+            state.framebuffer = 0;
+        break;
+    case GpuKind::Program:
+        // a deleted program stays current until something else is bound
+        if (state.program == id)
+            state.program = unknownName;
+        break;
+    default:
+        break;
+    }
+}
+
+GLState::Stats GLState::GetStats()
+{
+    return stats;
+}
+
+GLState::Stats GLState::LastFrame()
+{
+    return lastFrame;
+}
+
+void GLState::EndFrame()
+{
+    lastFrame = stats;
+    stats = {};
+}
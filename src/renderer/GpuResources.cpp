@@ -0,0 +1,273 @@
+#include "renderer/GpuResources.hpp"
+#include "renderer/GLState.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    struct Resource
+    {
+        GpuKind kind;
+        GLuint id;
+        std::string label;
+        size_t bytes = 0;
+        uint64_t lastUse = 0;
+        std::function<bool()> evict;
+    };
+
+    const char *kindNames[] = {"buffers", "vertex arrays", "textures", "programs", "framebuffers", "queries"};
+    constexpr size_t kindCount = static_cast<size_t>(GpuKind::Count);
+
+    std::unordered_map<uint64_t, Resource> live;
+    size_t kindBytes[kindCount] = {};
+    size_t kindLive[kindCount] = {};
+    size_t peakBytes = 0;
+    size_t budget = 0;
+    uint64_t useClock = 0;
+
+    uint64_t Key(GpuKind kind, GLuint id)
+    {
+        return (static_cast<uint64_t>(kind) << 32) | id;
+    }
+
+    size_t Index(GpuKind kind)
+    {
+        return static_cast<size_t>(kind);
+    }
+
+    GLuint Track(GpuKind kind, GLuint id, const std::string &label)
+    {
+        if (!id)
+            return 0;
+        Resource r{kind, id, label};
+        r.lastUse = ++useClock;
+        live[Key(kind, id)] = std::move(r);
+        ++kindLive[Index(kind)];
+        return id;
+    }
+
+    void DeleteObject(GpuKind kind, GLuint id)
+    {
+        switch (kind)
+        {
+        case GpuKind::Buffer:
+            glDeleteBuffers(1, &id);
+            break;
+        case GpuKind::VertexArray:
+            glDeleteVertexArrays(1, &id);
+            break;
+        case GpuKind::Texture:
+            glDeleteTextures(1, &id);
+            break;
+        case GpuKind::Program:
+            glDeleteProgram(id);
+            break;
+        case GpuKind::Framebuffer:
+            glDeleteFramebuffers(1, &id);
+            break;
+        case GpuKind::Query:
+            glDeleteQueries(1, &id);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+GLuint GpuResources::CreateBuffer(const std::string &label)
+{
+    GLuint id = 0;
+    glGenBuffers(1, &id);
+    return Track(GpuKind::Buffer, id, label);
+}
+
+GLuint GpuResources::CreateVertexArray(const std::string &label)
+{
+    GLuint id = 0;
+    glGenVertexArrays(1, &id);
+    return Track(GpuKind::VertexArray, id, label);
+}
+
+GLuint GpuResources::CreateTexture(const std::string &label)
+{
+    GLuint id = 0;
+    glGenTextures(1, &id);
+    return Track(GpuKind::Texture, id, label);
+}
+
+GLuint GpuResources::CreateProgram(const std::string &label)
+{
+    return Track(GpuKind::Program, glCreateProgram(), label);
+}
+
+GLuint GpuResources::CreateFramebuffer(const std::string &label)
+{
+    GLuint id = 0;
+    glGenFramebuffers(1, &id);
+    return Track(GpuKind::Framebuffer, id, label);
+}
+
+GLuint GpuResources::CreateQuery(const std::string &label)
+{
+    GLuint id = 0;
+    glGenQueries(1, &id);
+    return Track(GpuKind::Query, id, label);
+}
+
+void GpuResources::Destroy(GpuKind kind, GLuint id)
+{
+    if (!id)
+        return;
+    auto it = live.find(Key(kind, id));
+    if (it != live.end())
+    {
+        kindBytes[Index(kind)] -= it->second.bytes;
+        --kindLive[Index(kind)];
+        live.erase(it);
+    }
+    DeleteObject(kind, id);
+    GLState::Forget(kind, id);
+}
+
+void GpuResources::SetBytes(GpuKind kind, GLuint id, size_t bytes)
+{
+    auto it = live.find(Key(kind, id));
+    if (it == live.end())
+        return;
+    size_t &total = kindBytes[Index(kind)];
+    total = total - it->second.bytes + bytes;
+    it->second.bytes = bytes;
+    peakBytes = std::max(peakBytes, TotalBytes());
+}
+
+void GpuResources::Touch(GpuKind kind, GLuint id)
+{
+    auto it = live.find(Key(kind, id));
+    if (it != live.end())
+        it->second.lastUse = ++useClock;
+}
+
+void GpuResources::SetReloadable(GpuKind kind, GLuint id, std::function<bool()> evict)
+{
+    auto it = live.find(Key(kind, id));
+    if (it != live.end())
+        it->second.evict = std::move(evict);
+}
+
+void GpuResources::SetBudget(size_t bytes)
+{
+    budget = bytes;
+}
+
+size_t GpuResources::GetBudget()
+{
+    return budget;
+}
+
+void GpuResources::EnforceBudget()
+{
+    if (budget == 0 || TotalBytes() <= budget)
+        return;
+
+    // oldest first; evict callbacks call Destroy, so work from a copy
+    std::vector<std::pair<uint64_t, uint64_t>> candidates; // lastUse, key
+    for (auto &[key, r] : live)
+    {
+        if (r.evict)
+            candidates.push_back({r.lastUse, key});
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    size_t evicted = 0;
+    size_t freed = 0;
+    for (auto &[use, key] : candidates)
+    {
+        if (TotalBytes() <= budget)
+            break;
+        auto it = live.find(key);
+        if (it == live.end())
+            continue;
+        size_t before = TotalBytes();
+        auto evict = it->second.evict; // the entry may be erased by the callback
+        if (evict())
+        {
+            ++evicted;
+            freed += before - TotalBytes();
+        }
+    }
+    if (evicted)
+        std::cerr << "GpuResources: evicted " << evicted << " reloadable objects (" << freed / 1024 << " KB) to fit budget of "
+                  << budget / (1024 * 1024) << " MB" << std::endl;
+}
+
+size_t GpuResources::Bytes(GpuKind kind)
+{
+    return kindBytes[Index(kind)];
+}
+
+size_t GpuResources::Count(GpuKind kind)
+{
+    return kindLive[Index(kind)];
+}
+
+size_t GpuResources::TotalBytes()
+{
+    size_t total = 0;
+    for (size_t b : kindBytes)
+        total += b;
+    return total;
+}
+
+size_t GpuResources::PeakBytes()
+{
+    return peakBytes;
+}
+
+void GpuResources::ForEach(GpuKind kind, const std::function<void(GLuint id, const std::string &label, size_t bytes)> &fn)
+{
+    std::vector<const Resource *> matches;
+    for (auto &[key, r] : live)
+    {
+        if (r.kind == kind)
+            matches.push_back(&r);
+    }
+    std::sort(matches.begin(), matches.end(), [](const Resource *a, const Resource *b)
+              { return a->bytes > b->bytes; });
+    for (const Resource *r : matches)
+        fn(r->id, r->label, r->bytes);
+}
+
+void GpuResources::Report(std::ostream &out)
+{
+    out << "GpuResources: usage (peak " << peakBytes / 1024 << " KB";
+    if (budget)
+        out << ", budget " << budget / 1024 << " KB";
+    out << ")" << std::endl;
+    for (size_t k = 0; k < kindCount; ++k)
+        out << "  " << kindNames[k] << ": " << kindLive[k] << " live, " << kindBytes[k] / 1024 << " KB" << std::endl;
+
+    if (live.empty())
+    {
+        out << "GpuResources: no leaks" << std::endl;
+        return;
+    }
+
+    std::vector<const Resource *> leaks;
+    for (auto &[key, r] : live)
+        leaks.push_back(&r);
+    std::sort(leaks.begin(), leaks.end(), [](const Resource *a, const Resource *b)
+              { return a->bytes > b->bytes; });
+
+    out << "GpuResources: " << leaks.size() << " objects still alive:" << std::endl;
+    const size_t maxLines = 32;
+    for (size_t i = 0; i < leaks.size() && i < maxLines; ++i)
+    {
+        const Resource *r = leaks[i];
+        out << "  " << kindNames[Index(r->kind)] << " #" << r->id << " " << r->bytes / 1024 << " KB '" << r->label << "'" << std::endl;
+    }
+    if (leaks.size() > maxLines)
+        out << "  ... and " << leaks.size() - maxLines << " more" << std::endl;
+}
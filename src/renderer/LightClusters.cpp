@@ -0,0 +1,231 @@
+#include "renderer/LightClusters.hpp"
+#include "renderer/GLState.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DUCK_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+    const char *labels[3] = {"cluster lights", "cluster grid", "cluster indices"};
+
+    int Cluster(int x, int y, int z)
+    {
+        return (z * LightClusters::tilesY + y) * LightClusters::tilesX + x;
+    }
+}
+
+void LightClusters::BuildBounds()
+{
+    minX.assign(clusterCount, 0.0f);
+    minY.assign(clusterCount, 0.0f);
+    minZ.assign(clusterCount, 0.0f);
+    maxX.assign(clusterCount, 0.0f);
+    maxY.assign(clusterCount, 0.0f);
+    maxZ.assign(clusterCount, 0.0f);
+
+    float tanY = std::tan(fovY * 0.5f);
+    float tanX = tanY * aspect;
+    for (int z = 0; z < slices; ++z)
+    {
+        // exponential slices: equal ratios of far to near depth
+        float d0 = zNear * std::pow(zFar / zNear, static_cast<float>(z) / slices);
+        float d1 = zNear * std::pow(zFar / zNear, static_cast<float>(z + 1) / slices);
+        for (int y = 0; y < tilesY; ++y)
+        {
+            float ny0 = -1.0f + 2.0f * y / tilesY, ny1 = -1.0f + 2.0f * (y + 1) / tilesY;
+            for (int x = 0; x < tilesX; ++x)
+            {
+                float nx0 = -1.0f + 2.0f * x / tilesX, nx1 = -1.0f + 2.0f * (x + 1) / tilesX;
+                int c = Cluster(x, y, z);
+                // the froxel widens with depth, so its box spans both depths' extents
+                minX[c] = std::min(nx0 * d0, nx0 * d1) * tanX;
+                maxX[c] = std::max(nx1 * d0, nx1 * d1) * tanX;
+                minY[c] = std::min(ny0 * d0, ny0 * d1) * tanY;
+                maxY[c] = std::max(ny1 * d0, ny1 * d1) * tanY;
+                minZ[c] = -d1;
+                maxZ[c] = -d0;
+            }
+        }
+    }
+}
+
+void LightClusters::BinLight(uint32_t index, const PointLight &light, std::vector<uint32_t> &hits) const
+{
+    const glm::vec3 &p = light.position;
+    float r = light.radius;
+    // view space looks down -z; depth is -z
+    float dMin = std::max(-p.z - r, zNear);
+    float dMax = -p.z + r;
+    if (dMax <= zNear || dMin >= zFar)
+        return;
+    dMax = std::min(dMax, zFar);
+
+    float logRatio = std::log(zFar / zNear);
+    int z0 = std::clamp(static_cast<int>(std::log(dMin / zNear) / logRatio * slices), 0, slices - 1);
+    int z1 = std::clamp(static_cast<int>(std::log(dMax / zNear) / logRatio * slices), 0, slices - 1);
+
+    // screen-space extent of the sphere's box: x/d is monotonic in both, so the corners bound it
+    float tanY = std::tan(fovY * 0.5f);
+    float tanX = tanY * aspect;
+    const float xs[2] = {p.x - r, p.x + r}, ys[2] = {p.y - r, p.y + r}, ds[2] = {dMin, dMax};
+    float nxMin = 1.0f, nxMax = -1.0f, nyMin = 1.0f, nyMax = -1.0f;
+    for (int i = 0; i < 4; ++i)
+    {
+        float nx = xs[i & 1] / (ds[i >> 1] * tanX);
+        float ny = ys[i & 1] / (ds[i >> 1] * tanY);
+        nxMin = std::min(nxMin, nx);
+        nxMax = std::max(nxMax, nx);
+        nyMin = std::min(nyMin, ny);
+        nyMax = std::max(nyMax, ny);
+    }
+    if (nxMax < -1.0f || nxMin > 1.0f || nyMax < -1.0f || nyMin > 1.0f)
+        return;
+    int x0 = std::clamp(static_cast<int>((nxMin * 0.5f + 0.5f) * tilesX), 0, tilesX - 1);
+    int x1 = std::clamp(static_cast<int>((nxMax * 0.5f + 0.5f) * tilesX), 0, tilesX - 1);
+    int y0 = std::clamp(static_cast<int>((nyMin * 0.5f + 0.5f) * tilesY), 0, tilesY - 1);
+    int y1 = std::clamp(static_cast<int>((nyMax * 0.5f + 0.5f) * tilesY), 0, tilesY - 1);
+
+    float r2 = r * r;
+    for (int z = z0; z <= z1; ++z)
+    {
+        for (int y = y0; y <= y1; ++y)
+        {
+            int row = Cluster(0, y, z);
+            int x = x0;
+#ifdef DUCK_SSE2
+            // exact sphere/box distance for four froxels of the row at once
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 px = _mm_set1_ps(p.x), py = _mm_set1_ps(p.y), pz = _mm_set1_ps(p.z);
+            const __m128 radius2 = _mm_set1_ps(r2);
+            for (; x + 3 <= x1; x += 4)
+            {
+                int c = row + x;
+                __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[c]), px), zero),
+                                       _mm_max_ps(_mm_sub_ps(px, _mm_loadu_ps(&maxX[c])), zero));
+                __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[c]), py), zero),
+                                       _mm_max_ps(_mm_sub_ps(py, _mm_loadu_ps(&maxY[c])), zero));
+                __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[c]), pz), zero),
+                                       _mm_max_ps(_mm_sub_ps(pz, _mm_loadu_ps(&maxZ[c])), zero));
+                __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                int mask = _mm_movemask_ps(_mm_cmple_ps(d2, radius2));
+                for (int lane = 0; lane < 4; ++lane)
+                {
+                    if (mask & (1 << lane))
+                        hits.push_back(static_cast<uint32_t>(c + lane) << 16 | index);
+                }
+            }
+#endif
+            for (; x <= x1; ++x)
+            {
+                int c = row + x;
+                float dx = std::max(minX[c] - p.x, 0.0f) + std::max(p.x - maxX[c], 0.0f);
+                float dy = std::max(minY[c] - p.y, 0.0f) + std::max(p.y - maxY[c], 0.0f);
+                float dz = std::max(minZ[c] - p.z, 0.0f) + std::max(p.z - maxZ[c], 0.0f);
+                if (dx * dx + dy * dy + dz * dz <= r2)
+                    hits.push_back(static_cast<uint32_t>(c) << 16 | index);
+            }
+        }
+    }
+}
+
+void LightClusters::Build(std::vector<PointLight> lights, float fov, float aspectRatio, float nearZ, float farZ)
+{
+    if (fov != fovY || aspectRatio != aspect || nearZ != zNear || farZ != zFar || minX.empty())
+    {
+        fovY = fov;
+        aspect = aspectRatio;
+        zNear = nearZ;
+        zFar = farZ;
+        BuildBounds();
+    }
+
+    if (lights.size() > maxLights)
+    {
+        std::partial_sort(lights.begin(), lights.begin() + maxLights, lights.end(), [](const PointLight &a, const PointLight &b)
+                          { return glm::dot(a.position, a.position) < glm::dot(b.position, b.position); });
+        lights.resize(maxLights);
+    }
+    lightCount = lights.size();
+
+    lightData.resize(lightCount * 8);
+    pairs.clear();
+    for (size_t i = 0; i < lightCount; ++i)
+    {
+        const PointLight &l = lights[i];
+        float *dst = lightData.data() + i * 8;
+        dst[0] = l.position.x;
+        dst[1] = l.position.y;
+        dst[2] = l.position.z;
+        dst[3] = l.radius;
+        dst[4] = l.color.r;
+        dst[5] = l.color.g;
+        dst[6] = l.color.b;
+        dst[7] = 0.0f;
+        BinLight(static_cast<uint32_t>(i), l, pairs);
+    }
+
+    // counting sort of the (froxel, light) pairs into per-froxel runs
+    grid.assign(clusterCount * 2, 0);
+    for (uint32_t pair : pairs)
+        ++grid[(pair >> 16) * 2 + 1];
+    uint32_t offset = 0;
+    for (int c = 0; c < clusterCount; ++c)
+    {
+        grid[c * 2] = offset;
+        offset += grid[c * 2 + 1];
+        grid[c * 2 + 1] = 0;
+    }
+    indices.resize(pairs.size());
+    for (uint32_t pair : pairs)
+    {
+        uint32_t c = pair >> 16;
+        indices[grid[c * 2] + grid[c * 2 + 1]++] = pair & 0xFFFF;
+    }
+}
+
+void LightClusters::Upload()
+{
+    // empty buffer textures are not allowed; keep one dummy element each
+    static const uint32_t zeros[8] = {};
+    const void *data[3] = {lightData.empty() ? zeros : static_cast<const void *>(lightData.data()), grid.data(),
+                           indices.empty() ? zeros : static_cast<const void *>(indices.data())};
+    size_t bytes[3] = {std::max<size_t>(lightData.size() * sizeof(float), sizeof(zeros)), grid.size() * sizeof(uint32_t),
+                       std::max<size_t>(indices.size() * sizeof(uint32_t), sizeof(uint32_t))};
+
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!buffers[i])
+        {
+            buffers[i] = GpuHandle(GpuKind::Buffer, GpuResources::CreateBuffer(labels[i]));
+            textures[i] = GpuHandle(GpuKind::Texture, GpuResources::CreateTexture(labels[i]));
+            GLState::BindTexture(0, GL_TEXTURE_BUFFER, textures[i].Get());
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i].Get());
+        }
+        // orphan, then refill: last frame's data may still be in use
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i].Get());
+        glBufferData(GL_TEXTURE_BUFFER, bytes[i], nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes[i], data[i]);
+        GpuResources::SetBytes(GpuKind::Buffer, buffers[i].Get(), bytes[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::Bind(GLuint firstUnit) const
+{
+    for (GLuint i = 0; i < 3; ++i)
+        GLState::BindTexture(firstUnit + i, GL_TEXTURE_BUFFER, textures[i].Get());
+}
+
+void LightClusters::Free()
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        textures[i].Reset();
+        buffers[i].Reset();
+    }
+}
@@ -0,0 +1,90 @@
+#include "renderer/OcclusionQueries.hpp"
+#include "renderer/GpuResources.hpp"
+
+void OcclusionQueries::BeginFrame()
+{
+    size_t pooled = stats.created;
+    stats = Stats();
+    stats.created = pooled;
+
+    // these were issued two frames ago; peek at them for the stats, never wait
+    for (GLuint query : retired)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint samples = 0;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+            if (samples)
+                ++stats.visible;
+            else
+                ++stats.occluded;
+        }
+        pool.push_back(query);
+    }
+    retired.clear();
+
+    for (auto it = slots.begin(); it != slots.end();)
+    {
+        Slot &slot = it->second;
+        if (slot.previous)
+            retired.push_back(slot.previous);
+        slot.previous = slot.current;
+        slot.current = 0;
+        // not queried last frame: nothing to condition on
+        if (!slot.previous)
+            it = slots.erase(it);
+        else
+            ++it;
+    }
+}
+
+GLuint OcclusionQueries::Condition(uint64_t key)
+{
+    auto it = slots.find(key);
+    if (it == slots.end() || !it->second.previous)
+        return 0;
+    ++stats.conditional;
+    return it->second.previous;
+}
+
+GLuint OcclusionQueries::Acquire()
+{
+    if (pool.empty())
+    {
+        GLuint query = GpuResources::CreateQuery("occlusion query");
+        created.push_back(query);
+        stats.created = created.size();
+        return query;
+    }
+    GLuint query = pool.front();
+    pool.pop_front();
+    return query;
+}
+
+void OcclusionQueries::Begin(uint64_t key)
+{
+    Slot &slot = slots[key];
+    if (slot.current)
+        pool.push_back(slot.current);
+    slot.current = Acquire();
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, slot.current);
+    ++stats.tracked;
+}
+
+void OcclusionQueries::End()
+{
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+}
+
+void OcclusionQueries::Free()
+{
+    for (GLuint query : created)
+        GpuResources::Destroy(GpuKind::Query, query);
+    created.clear();
+    pool.clear();
+    retired.clear();
+    slots.clear();
+    stats = Stats();
+}
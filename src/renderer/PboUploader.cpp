@@ -0,0 +1,205 @@
+#include "renderer/PboUploader.hpp"
+#include "renderer/GpuResources.hpp"
+#include "renderer/GLState.hpp"
+#include "ecs/AsyncTextureLoader.hpp"
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+
+namespace
+{
+    struct Request
+    {
+        GLuint tex = 0;
+        std::shared_ptr<DecodedImage> image;
+        TextureSettings settings;
+    };
+
+    struct Slot
+    {
+        GLuint pbo = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+        bool copying = false; // mapped and being filled by a worker
+        Request request;
+    };
+
+    struct Extent
+    {
+        int width = 0, height = 0, channels = 0;
+    };
+
+    std::vector<Slot> slots;
+    std::deque<Request> queued;
+    // storage currently allocated per texture, so same-sized re-uploads skip glTexImage2D
+    std::unordered_map<GLuint, Extent> extents;
+
+    GLenum FormatFor(int channels)
+    {
+        if (channels == 1)
+            return GL_RED;
+        if (channels == 4)
+            return GL_RGBA;
+        return GL_RGB;
+    }
+
+    bool SlotFree(Slot &slot)
+    {
+        if (slot.copying)
+            return false;
+        if (!slot.fence)
+            return true;
+        GLenum r = glClientWaitSync(slot.fence, 0, 0);
+        if (r != GL_ALREADY_SIGNALED && r != GL_CONDITION_SATISFIED)
+            return false;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        return true;
+    }
+
+    void Finish(size_t index)
+    {
+        Slot &slot = slots[index];
+        slot.copying = false;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        Request req = std::move(slot.request);
+        slot.request = {};
+        if (req.tex)
+        {
+            const DecodedImage &img = *req.image;
+            Extent &ext = extents[req.tex];
+            if (ext.width != img.width || ext.height != img.height || ext.channels != img.channels)
+            {
+                // (re)allocate storage without reading from the PBO; mipmaps come after the copy
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                Texture::Allocate(req.tex, img.width, img.height, img.channels, req.settings);
+                ext = {img.width, img.height, img.channels};
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+            }
+
+            GLState::BindTexture(0, GL_TEXTURE_2D, req.tex);
+            GLState::UnpackAlignment(1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, img.width, img.height, FormatFor(img.channels), GL_UNSIGNED_BYTE, (void *)0);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    void Start(size_t index, Request &&req)
+    {
+        Slot &slot = slots[index];
+        size_t bytes = req.image->pixels.size();
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+        if (bytes > slot.capacity)
+        {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            slot.capacity = bytes;
+            GpuResources::SetBytes(GpuKind::Buffer, slot.pbo, bytes);
+        }
+        // the fence has signalled, so nothing still reads this buffer
+        void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!dst)
+        {
+            std::cerr << "PboUploader: failed to map slot " << index << ", uploading directly" << std::endl;
+            if (req.tex)
+                Texture::Upload(req.tex, *req.image, req.settings);
+            return;
+        }
+
+        slot.copying = true;
+        slot.request = std::move(req);
+        std::shared_ptr<DecodedImage> image = slot.request.image;
+        AsyncTextureLoader::RunOnWorker([dst, image]()
+                                        { std::memcpy(dst, image->pixels.data(), image->pixels.size()); },
+                                        [index]()
+                                        { Finish(index); });
+    }
+}
+
+void PboUploader::Init(int count)
+{
+    if (!slots.empty())
+        return;
+    slots.resize(count);
+    for (auto &slot : slots)
+        slot.pbo = GpuResources::CreateBuffer("texture upload pbo");
+}
+
+void PboUploader::Shutdown()
+{
+    for (auto &slot : slots)
+    {
+        if (slot.copying)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        GpuResources::Destroy(GpuKind::Buffer, slot.pbo);
+    }
+    slots.clear();
+    queued.clear();
+    extents.clear();
+}
+
+bool PboUploader::IsActive()
+{
+    return !slots.empty();
+}
+
+void PboUploader::Upload(GLuint tex, DecodedImage &&image, const TextureSettings &settings)
+{
+    Request req;
+    req.tex = tex;
+    req.image = std::make_shared<DecodedImage>(std::move(image));
+    req.settings = settings;
+    queued.push_back(std::move(req));
+    Update();
+}
+
+void PboUploader::Cancel(GLuint tex)
+{
+    for (auto it = queued.begin(); it != queued.end();)
+        it = it->tex == tex ? queued.erase(it) : std::next(it);
+    for (auto &slot : slots)
+    {
+        if (slot.request.tex == tex)
+            slot.request.tex = 0;
+    }
+    extents.erase(tex);
+}
+
+void PboUploader::Update()
+{
+    for (size_t i = 0; i < slots.size() && !queued.empty(); ++i)
+    {
+        if (!SlotFree(slots[i]))
+            continue;
+        Request req = std::move(queued.front());
+        queued.pop_front();
+        Start(i, std::move(req));
+    }
+}
+
+size_t PboUploader::Pending()
+{
+    size_t n = queued.size();
+    for (auto &slot : slots)
+    {
+        if (slot.copying || slot.fence)
+            ++n;
+    }
+    return n;
+}
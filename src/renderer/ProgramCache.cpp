@@ -0,0 +1,171 @@
+#include "renderer/ProgramCache.hpp"
+#include "util/BinaryCache.hpp"
+#include <SDL3/SDL.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // not in our 3.3 loader, so fetched by hand
+    typedef void(APIENTRYP GetProgramBinaryFn)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+    typedef void(APIENTRYP ProgramBinaryFn)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+    typedef void(APIENTRYP ProgramParameteriFn)(GLuint program, GLenum pname, GLint value);
+
+    const GLenum programBinaryRetrievableHint = 0x8257;
+    const GLenum programBinaryLength = 0x8741;
+    const GLenum numProgramBinaryFormats = 0x87FE;
+
+    GetProgramBinaryFn getProgramBinary = nullptr;
+    ProgramBinaryFn programBinary = nullptr;
+    ProgramParameteriFn programParameteri = nullptr;
+
+    std::string cacheDir;
+    uint64_t driverHash = 0;
+    bool available = false;
+    ProgramCache::Stats stats;
+
+    const char magic[4] = {'P', 'B', 'I', 'N'};
+    // bump when the entry layout changes
+    const uint32_t formatVersion = 1;
+
+    std::string PathFor(uint64_t key)
+    {
+        return BinaryCache::PathFor(cacheDir, key, ".bin");
+    }
+}
+
+void ProgramCache::Init(const std::string &directory)
+{
+    cacheDir = directory;
+    available = false;
+
+    GLint major = 0, minor = 0;
+    // drivers often hand out a newer context than the 3.3 we ask for
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    bool core41 = major > 4 || (major == 4 && minor >= 1);
+    if (!core41 && !SDL_GL_ExtensionSupported("GL_ARB_get_program_binary"))
+    {
+        std::cerr << "ProgramCache: program binaries not supported, compiling from source" << std::endl;
+        return;
+    }
+
+    getProgramBinary = reinterpret_cast<GetProgramBinaryFn>(SDL_GL_GetProcAddress("glGetProgramBinary"));
+    programBinary = reinterpret_cast<ProgramBinaryFn>(SDL_GL_GetProcAddress("glProgramBinary"));
+    programParameteri = reinterpret_cast<ProgramParameteriFn>(SDL_GL_GetProcAddress("glProgramParameteri"));
+    GLint formats = 0;
+    glGetIntegerv(numProgramBinaryFormats, &formats);
+    if (!getProgramBinary || !programBinary || !programParameteri || formats <= 0)
+    {
+        std::cerr << "ProgramCache: driver exposes no program binary formats, compiling from source" << std::endl;
+        return;
+    }
+
+    std::error_code ec;
+    fs::create_directories(cacheDir, ec);
+    if (ec)
+    {
+        std::cerr << "ProgramCache: cannot create " << cacheDir << ": " << ec.message() << std::endl;
+        return;
+    }
+
+    using BinaryCache::HashString;
+    driverHash = BinaryCache::fnvOffset;
+    driverHash = HashString(reinterpret_cast<const char *>(glGetString(GL_VENDOR)), driverHash);
+    driverHash = HashString(reinterpret_cast<const char *>(glGetString(GL_RENDERER)), driverHash);
+    driverHash = HashString(reinterpret_cast<const char *>(glGetString(GL_VERSION)), driverHash);
+    available = true;
+}
+
+bool ProgramCache::Available()
+{
+    return available;
+}
+
+uint64_t ProgramCache::Key(const char *vertexSrc, const char *fragmentSrc)
+{
+    uint64_t hash = driverHash ? driverHash : BinaryCache::fnvOffset;
+    hash = BinaryCache::HashString(vertexSrc, hash);
+    return BinaryCache::HashString(fragmentSrc, hash);
+}
+
+void ProgramCache::PrepareForLink(GLuint program)
+{
+    if (available)
+        programParameteri(program, programBinaryRetrievableHint, GL_TRUE);
+}
+
+bool ProgramCache::Load(GLuint program, uint64_t key)
+{
+    if (!available)
+        return false;
+
+    std::string path = PathFor(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        ++stats.misses;
+        return false;
+    }
+    // header, the driver's binary format, then the binary
+    GLenum format = 0;
+    bool ok = BinaryCache::ReadHeader(in, magic, formatVersion, key) && BinaryCache::Read(in, format);
+    std::vector<char> bytes;
+    if (ok)
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    in.close();
+
+    ok = ok && !bytes.empty();
+    if (ok)
+    {
+        programBinary(program, format, bytes.data(), static_cast<GLsizei>(bytes.size()));
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        ok = linked == GL_TRUE;
+    }
+    if (!ok)
+    {
+        // stale or corrupt; the caller links from source and stores a fresh one
+        ++stats.rejected;
+        std::error_code ec;
+        fs::remove(path, ec);
+        return false;
+    }
+    ++stats.hits;
+    return true;
+}
+
+void ProgramCache::Store(GLuint program, uint64_t key)
+{
+    if (!available)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, programBinaryLength, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    getProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+        return;
+
+    bool stored = BinaryCache::WriteAtomic(PathFor(key), [&](std::ostream &out)
+                                           {
+        BinaryCache::WriteHeader(out, magic, formatVersion, key);
+        BinaryCache::Write(out, format);
+        out.write(binary.data(), written); });
+    if (stored)
+        ++stats.stored;
+}
+
+ProgramCache::Stats ProgramCache::GetStats()
+{
+    return stats;
+}
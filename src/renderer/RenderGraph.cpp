@@ -0,0 +1,507 @@
+#include "renderer/RenderGraph.hpp"
+#include "renderer/GLState.hpp"
+#include "renderer/GpuResources.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <queue>
+
+namespace
+{
+    bool IsDepthFormat(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_DEPTH_COMPONENT16:
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32F:
+        case GL_DEPTH24_STENCIL8:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // external format/type pair that glTexImage2D accepts for an internal format
+    void UploadFormat(GLenum internalFormat, GLenum &format, GLenum &type)
+    {
+        switch (internalFormat)
+        {
+        case GL_DEPTH24_STENCIL8:
+            format = GL_DEPTH_STENCIL;
+            type = GL_UNSIGNED_INT_24_8;
+            break;
+        case GL_DEPTH_COMPONENT16:
+        case GL_DEPTH_COMPONENT24:
+            format = GL_DEPTH_COMPONENT;
+            type = GL_UNSIGNED_INT;
+            break;
+        case GL_DEPTH_COMPONENT32F:
+            format = GL_DEPTH_COMPONENT;
+            type = GL_FLOAT;
+            break;
+        case GL_R8:
+            format = GL_RED;
+            type = GL_UNSIGNED_BYTE;
+            break;
+        case GL_RGBA16F:
+        case GL_RGBA32F:
+            format = GL_RGBA;
+            type = GL_FLOAT;
+            break;
+        default:
+            format = GL_RGBA;
+            type = GL_UNSIGNED_BYTE;
+            break;
+        }
+    }
+
+    size_t BytesPerPixel(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_R8:
+            return 1;
+        case GL_DEPTH_COMPONENT16:
+            return 2;
+        case GL_RGBA16F:
+            return 8;
+        case GL_RGBA32F:
+            return 16;
+        default:
+            return 4;
+        }
+    }
+
+    // smoothing factor for the per-pass timings shown in the debug UI
+    const double timingBlend = 0.1;
+
+    void Smooth(double &value, double sample)
+    {
+        value = value == 0.0 ? sample : value + (sample - value) * timingBlend;
+    }
+}
+
+RenderGraph::Resource RenderGraph::Import(const std::string &name)
+{
+    ResourceInfo info;
+    info.name = name;
+    info.imported = true;
+    resources.push_back(info);
+    dirty = true;
+    return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::CreateTexture(const std::string &name, const TextureDesc &desc)
+{
+    ResourceInfo info;
+    info.name = name;
+    info.desc = desc;
+    resources.push_back(info);
+    dirty = true;
+    return static_cast<Resource>(resources.size() - 1);
+}
+
+void RenderGraph::MarkOutput(Resource resource)
+{
+    if (resource >= 0 && resource < static_cast<Resource>(resources.size()))
+        resources[resource].output = true;
+    dirty = true;
+}
+
+void RenderGraph::AddPass(Pass pass)
+{
+    PassStats s;
+    s.name = pass.name;
+    stats.push_back(s);
+    passes.push_back(std::move(pass));
+    passState.emplace_back();
+    dirty = true;
+}
+
+void RenderGraph::SetEnabled(const std::string &name, bool enabled)
+{
+    for (size_t i = 0; i < passes.size(); ++i)
+    {
+        if (passes[i].name == name && passState[i].enabled != enabled)
+        {
+            passState[i].enabled = enabled;
+            dirty = true;
+        }
+    }
+}
+
+bool RenderGraph::IsEnabled(const std::string &name) const
+{
+    for (size_t i = 0; i < passes.size(); ++i)
+    {
+        if (passes[i].name == name)
+            return passState[i].enabled;
+    }
+    return false;
+}
+
+bool RenderGraph::Compile()
+{
+    const GLState::Viewport &vp = GLState::GetViewport();
+    compiledWidth = vp.width;
+    compiledHeight = vp.height;
+    dirty = false;
+
+    if (!BuildOrder())
+    {
+        std::cerr << "RenderGraph: dependency cycle, nothing will be drawn" << std::endl;
+        order.clear();
+        return false;
+    }
+    Cull();
+    Allocate(vp.width, vp.height);
+    return true;
+}
+
+bool RenderGraph::BuildOrder()
+{
+    // writers of a resource run in the order they were added. a pure reader
+    // waits for the last writer added before it (or, if it was added first,
+    // for the last writer overall) and runs before the next writer after it.
+    size_t count = passes.size();
+    std::vector<std::vector<size_t>> after(count); // edges: pass -> passes that wait for it
+    std::vector<int> waiting(count, 0);
+    auto edge = [&](size_t from, size_t to)
+    {
+        if (from == to)
+            return;
+        after[from].push_back(to);
+        ++waiting[to];
+    };
+
+    for (Resource r = 0; r < static_cast<Resource>(resources.size()); ++r)
+    {
+        std::vector<size_t> writers;
+        for (size_t p = 0; p < count; ++p)
+        {
+            if (passState[p].enabled && std::find(passes[p].writes.begin(), passes[p].writes.end(), r) != passes[p].writes.end())
+                writers.push_back(p);
+        }
+        for (size_t w = 1; w < writers.size(); ++w)
+            edge(writers[w - 1], writers[w]);
+
+        for (size_t p = 0; p < count; ++p)
+        {
+            const Pass &pass = passes[p];
+            if (!passState[p].enabled || writers.empty() ||
+                std::find(pass.reads.begin(), pass.reads.end(), r) == pass.reads.end() ||
+                std::find(pass.writes.begin(), pass.writes.end(), r) != pass.writes.end())
+                continue;
+            auto next = std::upper_bound(writers.begin(), writers.end(), p);
+            if (next == writers.begin())
+            {
+                edge(writers.back(), p);
+                continue;
+            }
+            edge(*(next - 1), p);
+            if (next != writers.end())
+                edge(p, *next);
+        }
+    }
+
+    // Kahn's algorithm, preferring the order passes were added in
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> ready;
+    size_t enabled = 0;
+    for (size_t p = 0; p < count; ++p)
+    {
+        if (!passState[p].enabled)
+            continue;
+        ++enabled;
+        if (waiting[p] == 0)
+            ready.push(p);
+    }
+    order.clear();
+    while (!ready.empty())
+    {
+        size_t p = ready.top();
+        ready.pop();
+        order.push_back(p);
+        for (size_t next : after[p])
+        {
+            if (--waiting[next] == 0)
+                ready.push(next);
+        }
+    }
+    return order.size() == enabled;
+}
+
+void RenderGraph::Cull()
+{
+    // walk back from the outputs: a pass lives if a live pass (or an output)
+    // depends on something it writes
+    std::vector<bool> alive(passes.size(), false);
+    std::vector<bool> needed(resources.size(), false);
+    for (size_t r = 0; r < resources.size(); ++r)
+        needed[r] = resources[r].output;
+
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        const Pass &pass = passes[*it];
+        bool live = pass.sideEffects;
+        for (Resource w : pass.writes)
+            live = live || needed[w];
+        if (!live)
+            continue;
+        alive[*it] = true;
+        for (Resource r : pass.reads)
+            needed[r] = true;
+    }
+
+    for (size_t p = 0; p < passes.size(); ++p)
+        stats[p].culled = !alive[p];
+    order.erase(std::remove_if(order.begin(), order.end(), [&](size_t p)
+                               { return !alive[p]; }),
+                order.end());
+}
+
+void RenderGraph::Allocate(int viewportWidth, int viewportHeight)
+{
+    // lifetime of every transient resource in execution order
+    std::vector<int> first(resources.size(), -1), last(resources.size(), -1);
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const Pass &pass = passes[order[i]];
+        for (const std::vector<Resource> *list : {&pass.reads, &pass.writes})
+        {
+            for (Resource r : *list)
+            {
+                if (resources[r].imported)
+                    continue;
+                if (first[r] < 0)
+                    first[r] = static_cast<int>(i);
+                last[r] = static_cast<int>(i);
+            }
+        }
+    }
+
+    std::vector<Resource> transient;
+    for (Resource r = 0; r < static_cast<Resource>(resources.size()); ++r)
+    {
+        resources[r].physical = -1;
+        if (first[r] >= 0)
+            transient.push_back(r);
+    }
+    std::sort(transient.begin(), transient.end(), [&](Resource a, Resource b)
+              { return first[a] < first[b]; });
+
+    // greedy: reuse any texture of the same shape whose previous user is done
+    std::vector<bool> used(physical.size(), false);
+    for (Physical &p : physical)
+        p.lastUse = -1;
+    for (Resource r : transient)
+    {
+        TextureDesc desc = resources[r].desc;
+        if (desc.width <= 0)
+            desc.width = std::max(1, viewportWidth);
+        if (desc.height <= 0)
+            desc.height = std::max(1, viewportHeight);
+
+        int slot = -1;
+        for (size_t i = 0; i < physical.size() && slot < 0; ++i)
+        {
+            if (physical[i].desc == desc && physical[i].lastUse < first[r])
+                slot = static_cast<int>(i);
+        }
+        if (slot < 0)
+        {
+            Physical p;
+            p.desc = desc;
+            p.texture = GpuResources::CreateTexture("render graph " + resources[r].name);
+            GLenum format, type;
+            UploadFormat(desc.internalFormat, format, type);
+            GLState::BindTexture(0, GL_TEXTURE_2D, p.texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, format, type, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            GpuResources::SetBytes(GpuKind::Texture, p.texture, static_cast<size_t>(desc.width) * desc.height * BytesPerPixel(desc.internalFormat));
+            physical.push_back(p);
+            used.push_back(false);
+            slot = static_cast<int>(physical.size() - 1);
+        }
+        physical[slot].lastUse = last[r];
+        used[slot] = true;
+        resources[r].physical = slot;
+    }
+
+    // drop textures no resource maps to any more (e.g. after a resize)
+    std::vector<int> remap(physical.size(), -1);
+    std::vector<Physical> kept;
+    for (size_t i = 0; i < physical.size(); ++i)
+    {
+        if (used[i])
+        {
+            remap[i] = static_cast<int>(kept.size());
+            kept.push_back(physical[i]);
+        }
+        else
+            GpuResources::Destroy(GpuKind::Texture, physical[i].texture);
+    }
+    physical = std::move(kept);
+    for (ResourceInfo &info : resources)
+    {
+        if (info.physical >= 0)
+            info.physical = remap[info.physical];
+    }
+
+    // one framebuffer per pass that renders into transient textures
+    for (size_t p = 0; p < passes.size(); ++p)
+    {
+        PassState &state = passState[p];
+        std::vector<GLuint> colors;
+        GLuint depth = 0;
+        bool depthStencil = false;
+        for (Resource w : passes[p].writes)
+        {
+            const ResourceInfo &info = resources[w];
+            if (info.imported || info.physical < 0)
+                continue;
+            const Physical &target = physical[info.physical];
+            if (IsDepthFormat(target.desc.internalFormat))
+            {
+                depth = target.texture;
+                depthStencil = target.desc.internalFormat == GL_DEPTH24_STENCIL8;
+            }
+            else
+                colors.push_back(target.texture);
+        }
+        if (colors.empty() && !depth)
+        {
+            GpuResources::Destroy(GpuKind::Framebuffer, state.framebuffer);
+            state.framebuffer = 0;
+            continue;
+        }
+
+        if (!state.framebuffer)
+            state.framebuffer = GpuResources::CreateFramebuffer("render graph " + passes[p].name);
+        GLState::BindFramebuffer(state.framebuffer);
+        std::vector<GLenum> drawBuffers;
+        for (size_t c = 0; c < colors.size(); ++c)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(c), GL_TEXTURE_2D, colors[c], 0);
+            drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(c));
+        }
+        glFramebufferTexture2D(GL_FRAMEBUFFER, depthStencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        if (drawBuffers.empty())
+        {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        else
+            glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "RenderGraph: framebuffer for pass '" << passes[p].name << "' is incomplete" << std::endl;
+    }
+    GLState::BindFramebuffer(0);
+}
+
+void RenderGraph::BindTargets(size_t pass)
+{
+    const PassState &state = passState[pass];
+    GLState::BindFramebuffer(state.framebuffer);
+    if (!state.framebuffer)
+    {
+        GLState::SetViewport(0, 0, compiledWidth, compiledHeight);
+        return;
+    }
+    // transient targets may be sized independently of the window
+    for (Resource w : passes[pass].writes)
+    {
+        const ResourceInfo &info = resources[w];
+        if (!info.imported && info.physical >= 0)
+        {
+            const TextureDesc &desc = physical[info.physical].desc;
+            GLState::SetViewport(0, 0, desc.width, desc.height);
+            return;
+        }
+    }
+}
+
+void RenderGraph::Execute()
+{
+    const GLState::Viewport &vp = GLState::GetViewport();
+    if (dirty || vp.width != compiledWidth || vp.height != compiledHeight)
+        Compile();
+
+    int slot = static_cast<int>(frame % queryFrames);
+    for (size_t p : order)
+    {
+        PassState &state = passState[p];
+        PassStats &s = stats[p];
+
+        // this slot's query is queryFrames old; read it only if it is done so we never stall
+        if (state.queryIssued[slot])
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(state.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(state.queries[slot], GL_QUERY_RESULT, &ns);
+                Smooth(s.gpuMs, ns / 1.0e6);
+            }
+        }
+        if (!state.queries[slot])
+            state.queries[slot] = GpuResources::CreateQuery("render graph " + passes[p].name);
+
+        auto start = std::chrono::steady_clock::now();
+        BindTargets(p);
+        glBeginQuery(GL_TIME_ELAPSED, state.queries[slot]);
+        passes[p].execute();
+        glEndQuery(GL_TIME_ELAPSED);
+        state.queryIssued[slot] = true;
+        Smooth(s.cpuMs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    // leave the window bound for whatever draws after the graph
+    GLState::BindFramebuffer(0);
+    GLState::SetViewport(0, 0, compiledWidth, compiledHeight);
+    ++frame;
+}
+
+GLuint RenderGraph::Texture(Resource resource) const
+{
+    if (resource < 0 || resource >= static_cast<Resource>(resources.size()))
+        return 0;
+    int slot = resources[resource].physical;
+    return slot >= 0 ? physical[slot].texture : 0;
+}
+
+size_t RenderGraph::TransientCount() const
+{
+    size_t count = 0;
+    for (const ResourceInfo &info : resources)
+    {
+        if (info.physical >= 0)
+            ++count;
+    }
+    return count;
+}
+
+void RenderGraph::Release()
+{
+    for (Physical &p : physical)
+        GpuResources::Destroy(GpuKind::Texture, p.texture);
+    physical.clear();
+    for (ResourceInfo &info : resources)
+        info.physical = -1;
+    for (PassState &state : passState)
+    {
+        GpuResources::Destroy(GpuKind::Framebuffer, state.framebuffer);
+        state.framebuffer = 0;
+        for (int i = 0; i < queryFrames; ++i)
+        {
+            GpuResources::Destroy(GpuKind::Query, state.queries[i]);
+            state.queries[i] = 0;
+            state.queryIssued[i] = false;
+        }
+    }
+    dirty = true;
+}
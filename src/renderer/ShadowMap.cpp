@@ -0,0 +1,139 @@
+#include "renderer/ShadowMap.hpp"
+#include "renderer/GLState.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    // maps clip space [-1, 1] to texture space [0, 1]
+    const glm::mat4 bias = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+
+    glm::mat4 LightView(const glm::vec3 &toLight, const glm::vec3 &target)
+    {
+        glm::vec3 dir = glm::normalize(toLight);
+        glm::vec3 up = std::abs(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        return glm::lookAt(target + dir, target, up);
+    }
+}
+
+void ShadowMap::Create(Layer &layer, int size, const char *label)
+{
+    layer.texture = GpuHandle(GpuKind::Texture, GpuResources::CreateTexture(label));
+    GLState::BindTexture(0, GL_TEXTURE_2D, layer.texture.Get());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // lookups past the edge compare against the far plane: lit
+    const float border[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+    // linear filtering of a comparison is 2x2 PCF for free
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    GpuResources::SetBytes(GpuKind::Texture, layer.texture.Get(), static_cast<size_t>(size) * size * 4);
+
+    layer.framebuffer = GpuHandle(GpuKind::Framebuffer, GpuResources::CreateFramebuffer(label));
+    GLState::BindFramebuffer(layer.framebuffer.Get());
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, layer.texture.Get(), 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+}
+
+void ShadowMap::Render(Layer &layer, int size, const glm::mat4 &view, const glm::mat4 &proj, const DrawFn &draw)
+{
+    if (!layer.framebuffer)
+        Create(layer, size, &layer == &staticLayer ? "static shadow map" : "dynamic shadow map");
+
+    GLState::Viewport previous = GLState::GetViewport();
+    GLState::BindFramebuffer(layer.framebuffer.Get());
+    GLState::SetViewport(0, 0, size, size);
+    GLState::DepthMask(true);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    // push depths back a little so lit surfaces don't shadow themselves
+    GLState::Enable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+    draw(view, proj);
+    GLState::Disable(GL_POLYGON_OFFSET_FILL);
+    GLState::BindFramebuffer(0);
+    GLState::SetViewport(previous.x, previous.y, previous.width, previous.height);
+}
+
+bool ShadowMap::UpdateStatic(const glm::vec3 &toLight, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float period,
+                             const DrawFn &draw)
+{
+    if (staticValid && toLight == staticLight && boundsMin == staticMin && boundsMax == staticMax && period == staticPeriod)
+        return false;
+
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::mat4 view = LightView(toLight, center);
+
+    // x/y fit the copy receivers look up in; depth also covers the
+    // neighbouring copies so their casters are not clipped
+    const float inf = std::numeric_limits<float>::infinity();
+    glm::vec3 lo(inf), hi(-inf);
+    for (int shift = -1; shift <= 1; ++shift)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y,
+                             ((i & 4) ? boundsMax.z : boundsMin.z) + shift * period);
+            glm::vec3 p = glm::vec3(view * glm::vec4(corner, 1.0f));
+            if (shift == 0)
+            {
+                lo.x = std::min(lo.x, p.x);
+                lo.y = std::min(lo.y, p.y);
+                hi.x = std::max(hi.x, p.x);
+                hi.y = std::max(hi.y, p.y);
+            }
+            lo.z = std::min(lo.z, p.z);
+            hi.z = std::max(hi.z, p.z);
+        }
+    }
+    // the view looks down -z, so near and far are negated
+    glm::mat4 proj = glm::ortho(lo.x, hi.x, lo.y, hi.y, -hi.z - 0.1f, -lo.z + 0.1f);
+
+    Render(staticLayer, staticSize, view, proj, draw);
+    staticMatrix = bias * proj * view;
+    staticValid = true;
+    staticLight = toLight;
+    staticMin = boundsMin;
+    staticMax = boundsMax;
+    staticPeriod = period;
+    ++staticRenders;
+    return true;
+}
+
+void ShadowMap::UpdateDynamic(const glm::vec3 &toLight, const glm::vec3 &focus, float radius, const DrawFn &draw)
+{
+    // a fixed light view through the origin; the box moves in whole texels
+    glm::mat4 view = LightView(toLight, glm::vec3(0.0f));
+    glm::vec3 f = glm::vec3(view * glm::vec4(focus, 1.0f));
+    float texel = 2.0f * radius / dynamicSize;
+    f.x = std::floor(f.x / texel) * texel;
+    f.y = std::floor(f.y / texel) * texel;
+    // casters well above the box (toward the light) still count
+    glm::mat4 proj = glm::ortho(f.x - radius, f.x + radius, f.y - radius, f.y + radius, -f.z - radius * 4.0f, -f.z + radius);
+
+    Render(dynamicLayer, dynamicSize, view, proj, draw);
+    dynamicMatrix = bias * proj * view;
+    dynamicValid = true;
+}
+
+void ShadowMap::Bind(GLuint staticUnit, GLuint dynamicUnit) const
+{
+    GLState::BindTexture(staticUnit, GL_TEXTURE_2D, staticLayer.texture.Get());
+    GLState::BindTexture(dynamicUnit, GL_TEXTURE_2D, dynamicLayer.texture.Get());
+}
+
+void ShadowMap::Free()
+{
+    for (Layer *layer : {&staticLayer, &dynamicLayer})
+    {
+        layer->framebuffer.Reset();
+        layer->texture.Reset();
+    }
+    staticValid = dynamicValid = false;
+}
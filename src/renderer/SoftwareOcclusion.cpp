@@ -0,0 +1,238 @@
+#include "renderer/SoftwareOcclusion.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DUCK_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // box corners are indexed by bits: 1 = max x, 2 = max y, 4 = max z.
+    // faces wind counter-clockwise seen from outside, like every mesh here
+    const int boxFaces[6][4] = {
+        {0, 4, 6, 2}, // -x
+        {1, 3, 7, 5}, // +x
+        {0, 1, 5, 4}, // -y
+        {2, 6, 7, 3}, // +y
+        {0, 2, 3, 1}, // -z
+        {4, 5, 7, 6}, // +z
+    };
+
+    glm::vec3 Corner(const glm::vec3 &lo, const glm::vec3 &hi, int i)
+    {
+        return glm::vec3((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z);
+    }
+
+    // A * x + B * y + C, positive left of a -> b
+    struct Edge
+    {
+        float a, b, c;
+    };
+
+    template <typename V>
+    Edge MakeEdge(const V &from, const V &to)
+    {
+        return {from.y - to.y, to.x - from.x, from.x * to.y - from.y * to.x};
+    }
+}
+
+void SoftwareOcclusion::Begin(const glm::mat4 &matrix)
+{
+    viewProj = matrix;
+    depth.assign(static_cast<size_t>(width) * height, 0.0f);
+    stats = Stats();
+}
+
+void SoftwareOcclusion::AddOccluder(const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+{
+    glm::vec4 corners[8];
+    for (int i = 0; i < 8; ++i)
+        corners[i] = viewProj * glm::vec4(Corner(boxMin, boxMax, i), 1.0f);
+
+    for (const int *face : boxFaces)
+    {
+        const glm::vec4 quad[4] = {corners[face[0]], corners[face[1]], corners[face[2]], corners[face[3]]};
+        DrawQuad(quad);
+    }
+    ++stats.occluders;
+}
+
+void SoftwareOcclusion::DrawQuad(const glm::vec4 clip[4])
+{
+    // clip against the near plane (z >= -w); past it w is positive
+    glm::vec4 poly[5];
+    int count = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        const glm::vec4 &cur = clip[i];
+        const glm::vec4 &next = clip[(i + 1) % 4];
+        float dc = cur.z + cur.w, dn = next.z + next.w;
+        if (dc >= 0.0f)
+            poly[count++] = cur;
+        if ((dc >= 0.0f) != (dn >= 0.0f))
+            poly[count++] = cur + (next - cur) * (dc / (dc - dn));
+    }
+    if (count < 3)
+        return;
+
+    ScreenVertex screen[5];
+    for (int i = 0; i < count; ++i)
+    {
+        float invW = 1.0f / poly[i].w;
+        screen[i] = {(poly[i].x * invW * 0.5f + 0.5f) * width, (poly[i].y * invW * 0.5f + 0.5f) * height, invW};
+    }
+
+    // back faces are hidden behind the front ones of the same box
+    float area = 0.0f;
+    for (int i = 0; i < count; ++i)
+    {
+        const ScreenVertex &p = screen[i], &q = screen[(i + 1) % count];
+        area += p.x * q.y - q.x * p.y;
+    }
+    if (area <= 0.0f)
+        return;
+
+    for (int i = 1; i + 1 < count; ++i)
+        DrawTriangle(screen[0], screen[i], screen[i + 1]);
+}
+
+void SoftwareOcclusion::DrawTriangle(const ScreenVertex &a, const ScreenVertex &b, const ScreenVertex &c)
+{
+    // pixels whose centers lie inside
+    int x0 = std::max(static_cast<int>(std::ceil(std::min({a.x, b.x, c.x}) - 0.5f)), 0);
+    int x1 = std::min(static_cast<int>(std::floor(std::max({a.x, b.x, c.x}) - 0.5f)), width - 1);
+    int y0 = std::max(static_cast<int>(std::ceil(std::min({a.y, b.y, c.y}) - 0.5f)), 0);
+    int y1 = std::min(static_cast<int>(std::floor(std::max({a.y, b.y, c.y}) - 0.5f)), height - 1);
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    // each edge function weighs the vertex opposite it
+    Edge ea = MakeEdge(b, c), eb = MakeEdge(c, a), ec = MakeEdge(a, b);
+    float area = ec.a * c.x + ec.b * c.y + ec.c;
+    if (area <= 0.0f)
+        return;
+    // 1 / w is a plane over the screen too
+    Edge z = {(ea.a * a.invW + eb.a * b.invW + ec.a * c.invW) / area, (ea.b * a.invW + eb.b * b.invW + ec.b * c.invW) / area,
+              (ea.c * a.invW + eb.c * b.invW + ec.c * c.invW) / area};
+
+    for (int y = y0; y <= y1; ++y)
+    {
+        float px = x0 + 0.5f, py = y + 0.5f;
+        float wa = ea.a * px + ea.b * py + ea.c;
+        float wb = eb.a * px + eb.b * py + eb.c;
+        float wc = ec.a * px + ec.b * py + ec.c;
+        float wz = z.a * px + z.b * py + z.c;
+        float *row = depth.data() + static_cast<size_t>(y) * width;
+        int x = x0;
+#ifdef DUCK_SSE2
+        // four pixels of the row at a time
+        const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        const __m128 zero = _mm_setzero_ps();
+        __m128 va = _mm_add_ps(_mm_set1_ps(wa), _mm_mul_ps(lanes, _mm_set1_ps(ea.a)));
+        __m128 vb = _mm_add_ps(_mm_set1_ps(wb), _mm_mul_ps(lanes, _mm_set1_ps(eb.a)));
+        __m128 vc = _mm_add_ps(_mm_set1_ps(wc), _mm_mul_ps(lanes, _mm_set1_ps(ec.a)));
+        __m128 vz = _mm_add_ps(_mm_set1_ps(wz), _mm_mul_ps(lanes, _mm_set1_ps(z.a)));
+        const __m128 stepA = _mm_set1_ps(ea.a * 4.0f), stepB = _mm_set1_ps(eb.a * 4.0f);
+        const __m128 stepC = _mm_set1_ps(ec.a * 4.0f), stepZ = _mm_set1_ps(z.a * 4.0f);
+        for (; x + 3 <= x1; x += 4)
+        {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(va, zero), _mm_cmpge_ps(vb, zero)), _mm_cmpge_ps(vc, zero));
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 nearer = _mm_max_ps(old, vz);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            va = _mm_add_ps(va, stepA);
+            vb = _mm_add_ps(vb, stepB);
+            vc = _mm_add_ps(vc, stepC);
+            vz = _mm_add_ps(vz, stepZ);
+        }
+        float skipped = static_cast<float>(x - x0);
+        wa += ea.a * skipped;
+        wb += eb.a * skipped;
+        wc += ec.a * skipped;
+        wz += z.a * skipped;
+#endif
+        for (; x <= x1; ++x)
+        {
+            if (wa >= 0.0f && wb >= 0.0f && wc >= 0.0f)
+                row[x] = std::max(row[x], wz);
+            wa += ea.a;
+            wb += eb.a;
+            wc += ec.a;
+            wz += z.a;
+        }
+    }
+}
+
+bool SoftwareOcclusion::IsVisible(const glm::vec3 &boxMin, const glm::vec3 &boxMax, const glm::mat4 &model)
+{
+    if (depth.empty())
+        return true;
+    ++stats.tested;
+    glm::mat4 m = viewProj * model;
+    const float inf = std::numeric_limits<float>::infinity();
+    float minX = inf, minY = inf, maxX = -inf, maxY = -inf;
+    float nearest = 0.0f;
+    glm::vec4 clip[8];
+    int behind = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        clip[i] = m * glm::vec4(Corner(boxMin, boxMax, i), 1.0f);
+        behind += clip[i].z < -clip[i].w;
+    }
+    // wholly behind the camera, or too close to project
+    if (behind == 8)
+    {
+        ++stats.culled;
+        return false;
+    }
+    if (behind > 0)
+        return true;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        float invW = 1.0f / clip[i].w;
+        float x = (clip[i].x * invW * 0.5f + 0.5f) * width;
+        float y = (clip[i].y * invW * 0.5f + 0.5f) * height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::max(nearest, invW);
+    }
+
+    // every pixel the screen rectangle touches
+    int x0 = std::max(static_cast<int>(std::floor(minX)), 0);
+    int x1 = std::min(static_cast<int>(std::floor(maxX)), width - 1);
+    int y0 = std::max(static_cast<int>(std::floor(minY)), 0);
+    int y1 = std::min(static_cast<int>(std::floor(maxY)), height - 1);
+    if (x0 > x1 || y0 > y1)
+    {
+        ++stats.culled;
+        return false;
+    }
+
+    // visible if any of them holds something farther than the box's nearest point
+    for (int y = y0; y <= y1; ++y)
+    {
+        const float *row = depth.data() + static_cast<size_t>(y) * width;
+        int x = x0;
+#ifdef DUCK_SSE2
+        const __m128 boxDepth = _mm_set1_ps(nearest);
+        for (; x + 3 <= x1; x += 4)
+        {
+            if (_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(row + x), boxDepth)))
+                return true;
+        }
+#endif
+        for (; x <= x1; ++x)
+        {
+            if (row[x] < nearest)
+                return true;
+        }
+    }
+    ++stats.culled;
+    return false;
+}
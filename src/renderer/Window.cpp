@@ -1,4 +1,5 @@
 #include "renderer/Window.hpp"
+#include "renderer/GLState.hpp"
 
 bool Window::Init(const char *title, int width, int height)
 {
@@ -51,17 +52,27 @@ void Window::BeginFrame()
   ImGui_ImplOpenGL3_NewFrame();
   ImGui_ImplSDL3_NewFrame();
   ImGui::NewFrame();
+  // the scene renders into the same viewport ImGui lays out for
+  GLState::SetViewport(0, 0, (int)io->DisplaySize.x, (int)io->DisplaySize.y);
 }
 
-void Window::EndFrame()
+void Window::RenderUI()
 {
   ImGui::Render();
-  glViewport(0, 0, (int)io->DisplaySize.x, (int)io->DisplaySize.y);
+  GLState::SetViewport(0, 0, (int)io->DisplaySize.x, (int)io->DisplaySize.y);
   // Don't clear the color buffer here — 3D scene has already been rendered
   // by the RenderSystem. Only clear depth so ImGui draws on top correctly.
+  GLState::DepthMask(true);
   glClearDepth(1.0);
   glClear(GL_DEPTH_BUFFER_BIT);
   ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+  // the backend binds its own program, VAO and textures behind GLState's back
+  GLState::Invalidate();
+}
+
+void Window::EndFrame()
+{
+  GLState::EndFrame();
   SDL_GL_SwapWindow(window);
 }
 
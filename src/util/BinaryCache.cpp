@@ -0,0 +1,79 @@
+#include "util/BinaryCache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const uint64_t fnvPrime = 1099511628211ull;
+}
+
+namespace BinaryCache
+{
+    uint64_t Fnv1a(const void *data, size_t size, uint64_t hash)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= p[i];
+            hash *= fnvPrime;
+        }
+        return hash;
+    }
+
+    uint64_t HashString(const char *s, uint64_t hash)
+    {
+        return s ? Fnv1a(s, std::strlen(s) + 1, hash) : Fnv1a("", 1, hash);
+    }
+
+    std::string PathFor(const std::string &directory, uint64_t key, const char *extension)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+        return (fs::path(directory) / (name + std::string(extension))).string();
+    }
+
+    bool ReadHeader(std::istream &in, const char (&magic)[4], uint32_t version, uint64_t key)
+    {
+        char fileMagic[4] = {};
+        uint32_t fileVersion = 0;
+        uint64_t fileKey = 0;
+        in.read(fileMagic, sizeof(fileMagic));
+        Read(in, fileVersion);
+        Read(in, fileKey);
+        return in && std::memcmp(fileMagic, magic, sizeof(magic)) == 0 && fileVersion == version && fileKey == key;
+    }
+
+    void WriteHeader(std::ostream &out, const char (&magic)[4], uint32_t version, uint64_t key)
+    {
+        out.write(magic, sizeof(magic));
+        Write(out, version);
+        Write(out, key);
+    }
+
+    bool WriteAtomic(const std::string &path, const std::function<void(std::ostream &)> &write)
+    {
+        std::error_code ec;
+        fs::path parent = fs::path(path).parent_path();
+        if (!parent.empty())
+            fs::create_directories(parent, ec);
+        std::string tmpPath = path + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary);
+            if (!out)
+                return false;
+            write(out);
+            if (!out)
+            {
+                out.close();
+                fs::remove(tmpPath, ec);
+                return false;
+            }
+        }
+        fs::rename(tmpPath, path, ec);
+        return !ec;
+    }
+}
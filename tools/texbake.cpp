@@ -0,0 +1,106 @@
+// offline texture baker: every .jpg/.png under the given directories gets a
+// .ktx with its full mip chain, plus a .bc.ktx (BC1/BC3) unless --no-compress.
+// images that already have up-to-date bakes are skipped.
+#include "ecs/ImageUtils.hpp"
+#include "ecs/Ktx.hpp"
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    bool IsSourceImage(const fs::path &p)
+    {
+        std::string ext = p.extension().string();
+        for (auto &ch : ext)
+            ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+        return ext == ".jpg" || ext == ".jpeg" || ext == ".png";
+    }
+
+    bool IsCurrent(const fs::path &baked, const fs::path &source)
+    {
+        std::error_code ec;
+        return fs::exists(baked, ec) && fs::last_write_time(baked, ec) >= fs::last_write_time(source, ec);
+    }
+
+    bool Bake(const fs::path &source, bool compress, int &written)
+    {
+        std::string src = source.string();
+        std::string plainPath = Ktx::PathFor(src, false);
+        std::string compressedPath = Ktx::PathFor(src, true);
+        bool needPlain = !IsCurrent(plainPath, source);
+        bool needCompressed = compress && !IsCurrent(compressedPath, source);
+        if (!needPlain && !needCompressed)
+            return true;
+
+        // rows bottom-up, the same as the runtime decode
+        DecodedImage image;
+        if (!ImageUtils::Decode(src, true, image))
+            return false;
+
+        if (needPlain)
+        {
+            if (!Ktx::Write(plainPath, Ktx::Build(image, false)))
+            {
+                std::cerr << "texbake: failed to write " << plainPath << std::endl;
+                return false;
+            }
+            ++written;
+            std::cout << "texbake: " << plainPath << std::endl;
+        }
+        if (needCompressed && (image.channels == 3 || image.channels == 4))
+        {
+            if (!Ktx::Write(compressedPath, Ktx::Build(image, true)))
+            {
+                std::cerr << "texbake: failed to write " << compressedPath << std::endl;
+                return false;
+            }
+            ++written;
+            std::cout << "texbake: " << compressedPath << std::endl;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool compress = true;
+    std::vector<fs::path> dirs;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--no-compress")
+            compress = false;
+        else
+            dirs.push_back(arg);
+    }
+    if (dirs.empty())
+    {
+        std::cerr << "usage: texbake [--no-compress] <dir>..." << std::endl;
+        return 1;
+    }
+
+    int written = 0;
+    int failed = 0;
+    for (const auto &dir : dirs)
+    {
+        std::error_code ec;
+        for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+        {
+            if (it->is_regular_file() && IsSourceImage(it->path()) && !Bake(it->path(), compress, written))
+                ++failed;
+        }
+        if (ec)
+        {
+            std::cerr << "texbake: cannot read " << dir << ": " << ec.message() << std::endl;
+            ++failed;
+        }
+    }
+
+    std::cout << "texbake: " << written << " files written, " << failed << " failed" << std::endl;
+    return failed ? 1 : 0;
+}